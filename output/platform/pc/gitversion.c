@@ -0,0 +1 @@
+const char * const gitversion = "b0924de5f9cce9834b4715813136a6b073f69ed9";
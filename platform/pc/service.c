@@ -210,8 +210,17 @@ void count_cpus_present(void)
     count_processors();
 }
 
+closure_function(0, 1, int, numa_cpu_from_apicid,
+                 u32, apic_id)
+{
+    return apic_lookup_cpuid(apic_id);
+}
+
 void start_secondary_cores(kernel_heaps kh)
 {
+    init_numa(heap_locked(kh), present_processors);
+    if (acpi_parse_numa(stack_closure(numa_cpu_from_apicid)))
+        init_debug("%d NUMA nodes", numa_nodes);
     memory_barrier();
     init_debug("init_mxcsr");
     init_mxcsr();
@@ -557,3 +557,9 @@ void send_ipi(u64 cpu, u8 vector)
         gicd_write_32(SGIR, sgi);
     }
 }
+
+void send_ipi_mask(bitmap targets, u8 vector)
+{
+    bitmap_foreach_set(targets, i)
+        send_ipi(i, vector);
+}
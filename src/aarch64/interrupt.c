@@ -295,6 +295,7 @@ void irq_handler(void)
     if (is_kernel_context(ctx) || is_syscall_context(ctx)) {
         context_release_refcount(ctx);
         if (saved_state != cpu_idle) {
+            bhqueue_handoff(ci);
             ci->state = cpu_kernel;
             frame_return(f);
         }
@@ -30,6 +30,14 @@ void flush_tlb(boolean full_flush)
         asm volatile("tlbi vmalle1is");
 }
 
+/* user mappings are all non-global with asid 0 */
+void flush_tlb_user(void)
+{
+    asm volatile("dsb ish;"
+                 "tlbi aside1is, %0;"
+                 "dsb ish" :: "r"(0ull) : "memory");
+}
+
 extern void *START, *READONLY_END, *END;
 extern void *LOAD_OFFSET;
 
@@ -275,6 +275,13 @@ static inline pageflags pageflags_default_user(void)
     return pageflags_user(pageflags_minpage(pageflags_memory()));
 }
 
+/* User mappings are tagged with the (single) ASID, so that flushing them by
+   ASID keeps the global kernel translations. */
+static inline pageflags pageflags_for_address(pageflags flags, u64 vaddr)
+{
+    return (pageflags){.w = vaddr < USER_LIMIT ? flags.w | PAGE_ATTR_nG : flags.w};
+}
+
 static inline boolean pageflags_is_present(pageflags flags)
 {
     return (flags.w & PAGE_L0_3_DESC_VALID) != 0;
@@ -135,6 +135,9 @@ static inline void thread_frame_save_fpsimd(context_frame f)
     if ((f[FRAME_TXCTX_FLAGS] & FRAME_TXCTX_FPSIMD_SAVED) == 0) {
         f[FRAME_TXCTX_FLAGS] |= FRAME_TXCTX_FPSIMD_SAVED;
         frame_save_fpsimd(f);
+        cpuinfo ci = current_cpu();
+        ci->fp_saves++;
+        ci->fp_save_bytes += FRAME_EXTENDED_MAX * sizeof(u64);
     }
 }
 
@@ -23,9 +23,30 @@
 #define RUNLOOP_TIMER_MAX_PERIOD_US     100000
 #define RUNLOOP_TIMER_MIN_PERIOD_US     1000
 
+/* kernel timer wheel tick, in log2 of timestamp units (~15us) */
+#define KERNEL_TIMER_WHEEL_TICK_ORDER   16
+
+/* idle polling window (enabled with the "idle_poll" option) */
+#define IDLE_POLL_DEFAULT_MAX_US        200
+#define IDLE_POLL_START_US              10
+#define IDLE_POLL_GROW_FACTOR           2
+#define IDLE_POLL_SHRINK_FACTOR         2
+
 /* length of thread scheduling queue */
 #define MAX_THREADS 8192
 
+/* per-cpu queue of threads scheduled from other CPUs, pending merge */
+#define SCHED_INBOX_SIZE 1024
+
+/* maximum queued threads on a CPU for a woken thread to stay there */
+#define SCHED_WAKE_AFFINE_MAX_QUEUED 1
+
+/* time slice of round-robin real-time threads */
+#define SCHED_RR_TIMESLICE_US 100000
+
+/* number of log2 microsecond buckets in scheduler latency histograms */
+#define SCHED_LATENCY_BUCKETS 24
+
 /* size of free context queues */
 #define FREE_KERNEL_CONTEXT_QUEUE_SIZE  8
 #define FREE_SYSCALL_CONTEXT_QUEUE_SIZE 8
@@ -33,10 +54,11 @@
 /* per-cpu queue */
 #define CPU_QUEUE_SIZE 512
 
-/* general scheduling queues */
-#define BHQUEUE_SIZE       8192
-#define RUNQUEUE_SIZE      8192
-#define ASYNC_QUEUE_1_SIZE 65536
+/* per-cpu deferred work queues; async_apply_1() overflows to a shared queue */
+#define BHQUEUE_SIZE           8192
+#define RUNQUEUE_SIZE          8192
+#define CPU_ASYNC_QUEUE_1_SIZE 4096
+#define ASYNC_QUEUE_1_SIZE     65536
 
 /* locking */
 #define MUTEX_ACQUIRE_SPIN_LIMIT (1ull << 20)
@@ -60,7 +82,8 @@
 #define XENNET_TX_SERVICEQUEUE_DEPTH 512
 
 /* mm stuff */
-#define MEM_CLEAN_THRESHOLD (64 * MB)
+#define MEM_CLEAN_THRESHOLD (64 * MB)    /* clean when free memory drops below */
+#define MEM_CLEAN_TARGET    (80 * MB)    /* until this much is free */
 #define PAGECACHE_SCAN_PERIOD_SECONDS 5
 #define PAGECACHE_MEMORY_RESERVE (4 * MB)
 #define USER_MEMORY_RESERVE (4 * MB)
@@ -76,6 +99,14 @@
 #define PAGECACHE_PAGES_RETAIN          64
 #define PAGECACHE_COMPLETIONS_RETAIN    64
 
+/* per-cpu magazines of locking object caches, refilled and flushed half at a time */
+#define OBJCACHE_MAGAZINE_SIZE          32
+
+/* per-cpu front caches of the locked general heap, for objects up to
+   (1 << MCACHE_FRONT_MAX_ORDER) bytes */
+#define MCACHE_FRONT_MAX_ORDER          10
+#define MCACHE_FRONT_SIZE               16
+
 /* must be large enough for vendor code that use malloc/free interface */
 #define MAX_MCACHE_ORDER 16
 
@@ -54,6 +54,91 @@ boolean acpi_parse_spcr(spcr_handler h)
     return true;
 }
 
+static void acpi_srat_cpu(acpi_cpu_mapper cpu_from_apicid, u32 apic_id, u32 domain)
+{
+    int cpu = apply(cpu_from_apicid, apic_id);
+    int node = numa_node_from_domain(domain, true);
+    if (cpu >= 0 && node >= 0)
+        numa_set_cpu_node(cpu, node);
+}
+
+static void acpi_parse_srat(acpi_cpu_mapper cpu_from_apicid)
+{
+    ACPI_TABLE_HEADER *srat;
+    ACPI_STATUS rv = AcpiGetTable(ACPI_SIG_SRAT, 1, &srat);
+    if (ACPI_FAILURE(rv))
+        return;
+    u8 *p = (u8 *)srat + sizeof(ACPI_TABLE_SRAT);
+    u8 *pe = (u8 *)srat + srat->Length;
+    for (; p < pe; p += ((ACPI_SUBTABLE_HEADER *)p)->Length) {
+        ACPI_SUBTABLE_HEADER *h = (ACPI_SUBTABLE_HEADER *)p;
+        if (h->Length == 0)
+            break;
+        switch (h->Type) {
+        case ACPI_SRAT_TYPE_CPU_AFFINITY: {
+            ACPI_SRAT_CPU_AFFINITY *a = (ACPI_SRAT_CPU_AFFINITY *)p;
+            if (!(a->Flags & ACPI_SRAT_CPU_USE_AFFINITY))
+                break;
+            u32 domain = a->ProximityDomainLo | (a->ProximityDomainHi[0] << 8) |
+                (a->ProximityDomainHi[1] << 16) | (a->ProximityDomainHi[2] << 24);
+            acpi_srat_cpu(cpu_from_apicid, a->ApicId, domain);
+            break;
+        }
+        case ACPI_SRAT_TYPE_X2APIC_CPU_AFFINITY: {
+            ACPI_SRAT_X2APIC_CPU_AFFINITY *a = (ACPI_SRAT_X2APIC_CPU_AFFINITY *)p;
+            if (a->Flags & ACPI_SRAT_CPU_ENABLED)
+                acpi_srat_cpu(cpu_from_apicid, a->ApicId, a->ProximityDomain);
+            break;
+        }
+        case ACPI_SRAT_TYPE_MEMORY_AFFINITY: {
+            ACPI_SRAT_MEM_AFFINITY *a = (ACPI_SRAT_MEM_AFFINITY *)p;
+            if (!(a->Flags & ACPI_SRAT_MEM_ENABLED) || a->Length == 0)
+                break;
+            int node = numa_node_from_domain(a->ProximityDomain, true);
+            if (node >= 0)
+                numa_add_memory(node, irangel(a->BaseAddress, a->Length));
+            break;
+        }
+        }
+    }
+    AcpiPutTable(srat);
+}
+
+static void acpi_parse_slit(void)
+{
+    ACPI_TABLE_HEADER *t;
+    ACPI_STATUS rv = AcpiGetTable(ACPI_SIG_SLIT, 1, &t);
+    if (ACPI_FAILURE(rv))
+        return;
+    ACPI_TABLE_SLIT *slit = (ACPI_TABLE_SLIT *)t;
+    u64 n = slit->LocalityCount;
+    if (sizeof(ACPI_TABLE_SLIT) - 1 + n * n <= t->Length) {
+        for (u64 i = 0; i < n; i++) {
+            int from = numa_node_from_domain(i, false);
+            if (from < 0)
+                continue;
+            for (u64 j = 0; j < n; j++) {
+                int to = numa_node_from_domain(j, false);
+                if (to >= 0)
+                    numa_set_distance(from, to, slit->Entry[i * n + j]);
+            }
+        }
+    }
+    AcpiPutTable(t);
+}
+
+/* Sets up the NUMA topology from the SRAT and SLIT tables; cpus are identified
+   in the SRAT by (x2)APIC id. */
+boolean acpi_parse_numa(acpi_cpu_mapper cpu_from_apicid)
+{
+    acpi_parse_srat(cpu_from_apicid);
+    if (numa_nodes <= 1)
+        return false;
+    acpi_parse_slit();
+    acpi_debug("%d NUMA nodes", numa_nodes);
+    return true;
+}
+
 closure_function(1, 0, void, acpi_eject,
                  ACPI_HANDLE, device)
 {
@@ -152,12 +152,14 @@ static inline boolean acpi_checksum(void *a, u8 len)
 typedef closure_type(madt_handler, void, u8, void *);
 typedef closure_type(mcfg_handler, boolean, u64, u16, u8, u8);
 typedef closure_type(spcr_handler, void, u8, u64);
+typedef closure_type(acpi_cpu_mapper, int, u32);
 
 void init_acpi(kernel_heaps kh);
 void init_acpi_tables(kernel_heaps kh);
 boolean acpi_walk_madt(madt_handler mh);
 boolean acpi_walk_mcfg(mcfg_handler mh);
 boolean acpi_parse_spcr(spcr_handler h);
+boolean acpi_parse_numa(acpi_cpu_mapper cpu_from_apicid);
 
 typedef struct acpi_mmio_dev {
     u64 membase;
@@ -634,7 +634,7 @@ hv_nv_on_device_add(struct hv_device *device, void *additional_info)
      */
     vmbus_chan_open(device->channel,
         NETVSC_DEVICE_RING_BUFFER_SIZE, NETVSC_DEVICE_RING_BUFFER_SIZE,
-        NULL, 0, hv_nv_on_channel_callback, device, runqueue);
+        NULL, 0, hv_nv_on_channel_callback, device, false);
     /*
      * Connect with the NetVsp
      */
@@ -283,7 +283,8 @@ netvsc_attach(kernel_heaps kh, hv_device* device)
               ethernet_input);
     lwip_unlock();
 
-    mm_register_mem_cleaner(init_closure(&hn->mem_cleaner, hn_mem_cleaner));
+    mm_register_mem_cleaner(init_closure(&hn->mem_cleaner, hn_mem_cleaner),
+                            "netvsc", MEM_CLEAN_COST_IDLE);
     netvsc_debug("%s: hwaddr %02x:%02x:%02x:%02x:%02x:%02x", __func__,
                  netif->hwaddr[0], netif->hwaddr[1], netif->hwaddr[2],
                  netif->hwaddr[3], netif->hwaddr[4], netif->hwaddr[5]);
@@ -480,7 +480,7 @@ static void hv_storvsc_connect_vsp(struct storvsc_softc *sc)
         sc->hs_drv_props->drv_ringbuffer_size,
         (void *)&props,
         sizeof(struct vmstor_chan_props),
-        hv_storvsc_on_channel_callback, sc, bhqueue);
+        hv_storvsc_on_channel_callback, sc, true);
 
     hv_storvsc_channel_init(sc);
 }
@@ -971,7 +971,8 @@ static status storvsc_attach(kernel_heaps kh, hv_device* device, storage_attach
     // setup hcb cache
     sc->hcb_objcache = allocate_objcache(sc->general, sc->contiguous,
                                          sizeof(struct storvsc_hcb), PAGESIZE_2M, true);
-    mm_register_mem_cleaner(init_closure(&sc->mem_cleaner, storvsc_mem_cleaner));
+    mm_register_mem_cleaner(init_closure(&sc->mem_cleaner, storvsc_mem_cleaner),
+                            "storvsc", MEM_CLEAN_COST_IDLE);
     sc->sa = a;
     sc->disks = allocate_vector(h, 1);
     spin_lock_init(&sc->disks_lock);
@@ -11,6 +11,15 @@ extern void notify_unix_timers_of_rtc_change(void);
 /* These should happen in pairs such that odd indicates update in-progress */
 #define vdso_update_gen() fetch_and_add((word *)&__vdso_dat->vdso_gen, 1)
 
+static void kernel_timers_reorder(void)
+{
+    cpuinfo ci;
+    vector_foreach(cpuinfos, ci) {
+        if (ci)
+            timer_reorder(ci->timers);
+    }
+}
+
 void kernel_delay(timestamp delta)
 {
     timestamp end = now(CLOCK_ID_MONOTONIC) + delta;
@@ -43,7 +52,7 @@ void clock_set_freq(s64 freq)
     __vdso_dat->base_freq = freq;
     __vdso_dat->last_raw = here;
     vdso_update_gen();
-    timer_reorder(kernel_timers);
+    kernel_timers_reorder();
 }
 
 void clock_set_slew(s64 slewfreq, timestamp start, u64 duration)
@@ -53,7 +62,7 @@ void clock_set_slew(s64 slewfreq, timestamp start, u64 duration)
     __vdso_dat->slew_start = start;
     __vdso_dat->slew_end = start + duration;
     vdso_update_gen();
-    timer_reorder(kernel_timers);
+    kernel_timers_reorder();
 }
 
 closure_function(1, 1, boolean, timer_adjust_handler,
@@ -75,13 +84,34 @@ closure_function(1, 1, boolean, timer_adjust_handler,
     return true;
 }
 
+/* All per-cpu queues are locked across the clock update so that no timer is
+   registered against a stale offset. */
+static void kernel_timers_adjust_begin(void)
+{
+    cpuinfo ci;
+    vector_foreach(cpuinfos, ci) {
+        if (ci)
+            timer_adjust_begin(ci->timers);
+    }
+}
+
+static void kernel_timers_adjust_end(s64 amt)
+{
+    pqueue_element_handler h = stack_closure(timer_adjust_handler, amt);
+    cpuinfo ci;
+    vector_foreach(cpuinfos, ci) {
+        if (ci)
+            timer_adjust_end(ci->timers, h);
+    }
+}
+
 void clock_step_rtc(s64 step)
 {
-    timer_adjust_begin(kernel_timers);
+    kernel_timers_adjust_begin();
     vdso_update_gen();
     __vdso_dat->rtc_offset += step;
     vdso_update_gen();
-    timer_adjust_end(kernel_timers, stack_closure(timer_adjust_handler, step));
+    kernel_timers_adjust_end(step);
     rtc_settimeofday(sec_from_timestamp(now(CLOCK_ID_REALTIME)));
     notify_unix_timers_of_rtc_change();
 }
@@ -93,7 +123,7 @@ void clock_reset_rtc(timestamp wallclock_now)
     timestamp n = now(CLOCK_ID_REALTIME);
     rtc_settimeofday(sec_from_timestamp(wallclock_now));
     notify_unix_timers_of_rtc_change();
-    timer_adjust_begin(kernel_timers);
+    kernel_timers_adjust_begin();
     reset_clock_vdso_dat();
-    timer_adjust_end(kernel_timers, stack_closure(timer_adjust_handler, wallclock_now - n));
+    kernel_timers_adjust_end(wallclock_now - n);
 }
@@ -15,6 +15,7 @@ static volatile boolean service_scheduled;
 BSS_RO_AFTER_INIT static thunk flush_service;
 BSS_RO_AFTER_INIT static queue flush_completion_queue;
 static struct rw_spinlock flush_lock;
+BSS_RO_AFTER_INIT static bitmap flush_targets;
 
 static void queue_flush_service(void);
 
@@ -26,6 +27,7 @@ struct flush_entry {
     u64 gen;
     struct refcount ref;
     boolean flush;
+    boolean kernel;     /* includes kernel addresses */
     u64 pages[FLUSH_THRESHOLD];
     int npages;
     status_handler completion;
@@ -44,8 +46,13 @@ static void _flush_handler(void)
     /* Each generation has at least one page, so if the gen difference is
      * greater than FLUSH_THRESHOLD, just do a full tlb flush */
     boolean full_flush = inval_gen - ci->inval_gen > FLUSH_THRESHOLD;
+    boolean kernel_flush = false;
 
     spin_rlock(&flush_lock);
+    if (ci->inval_deferred) {
+        ci->inval_deferred = false;
+        full_flush = true;
+    }
     while (ci->inval_gen != inval_gen) {
         word oldgen = ci->inval_gen;
         ci->inval_gen = inval_gen;
@@ -55,6 +62,8 @@ static void _flush_handler(void)
                 continue;
             if (f->gen > ci->inval_gen)
                 break;
+            if (f->kernel)
+                kernel_flush = true;
             if (!full_flush) {
                 if (f->flush)
                     full_flush = true;
@@ -68,7 +77,11 @@ static void _flush_handler(void)
     }
     spin_runlock(&flush_lock);
 
-    flush_tlb(full_flush);
+    /* kernel translations only need to go if a kernel mapping changed */
+    if (full_flush && !kernel_flush)
+        flush_tlb_user();
+    else
+        flush_tlb(full_flush);
 }
 
 closure_function(0, 0, void, flush_handler)
@@ -85,6 +98,8 @@ void page_invalidate_flush(void)
 void page_invalidate(flush_entry f, u64 p)
 {
     if (f && initialized) {
+        if (p >= USER_LIMIT)
+            f->kernel = true;
         if (f->flush)
             return;
         f->pages[f->npages++] = p;
@@ -95,6 +110,27 @@ void page_invalidate(flush_entry f, u64 p)
     }
 }
 
+/* An idle cpu touches no user memory before it catches up on invalidations in
+   the runloop, so flushes of user mappings can wait until then. If all of its
+   outstanding entries are for user mappings, release them on its behalf and
+   leave it a full flush. Called with flush_lock held for writing. */
+static boolean flush_defer_idle(cpuinfo ci)
+{
+    list_foreach(&entries, l) {
+        flush_entry f = struct_from_list(l, flush_entry, l);
+        if (f->gen > ci->inval_gen && f->kernel)
+            return false;
+    }
+    list_foreach(&entries, l) {
+        flush_entry f = struct_from_list(l, flush_entry, l);
+        if (f->gen > ci->inval_gen)
+            refcount_release(&f->ref);
+    }
+    ci->inval_gen = inval_gen;
+    ci->inval_deferred = true;
+    return true;
+}
+
 static void service_list(boolean trydefer)
 {
     list_foreach(&entries, l) {
@@ -175,9 +211,32 @@ void page_invalidate_sync(flush_entry f, status_handler completion)
         list_push_back(&entries, &f->l);
         entries_count++;
         f->gen = fetch_and_add((word *)&inval_gen, 1) + 1;
+
+        /* Interrupt only the cpus that can't defer the flush. The target mask
+           is shared, so send while it is protected by the lock. */
+        boolean broadcast = true;
+        if (!f->kernel) {
+            cpuinfo self = current_cpu();
+            boolean send = false;
+            bitmap_range_check_and_set(flush_targets, 0, total_processors, false, false);
+            for (int i = 0; i < total_processors; i++) {
+                cpuinfo ci = cpuinfo_from_id(i);
+                if (ci == self)
+                    continue;
+                if (ci->state == cpu_idle && flush_defer_idle(ci)) {
+                    broadcast = false;
+                    continue;
+                }
+                bitmap_set(flush_targets, i, 1);
+                send = true;
+            }
+            if (!broadcast && send)
+                send_ipi_mask(flush_targets, flush_ipi);
+        }
         spin_wunlock(&flush_lock);
 
-        send_ipi(TARGET_EXCLUSIVE_BROADCAST, flush_ipi);
+        if (broadcast)
+            send_ipi(TARGET_EXCLUSIVE_BROADCAST, flush_ipi);
         _flush_handler();
         irq_restore(flags);
     } else {
@@ -213,6 +272,9 @@ flush_entry get_page_flush_entry(void)
 void init_flush(heap h)
 {
     flush_ipi = allocate_ipi_interrupt();
+    flush_targets = allocate_bitmap(h, h, present_processors);
+    assert(flush_targets != INVALID_ADDRESS);
+    bitmap_alloc(flush_targets, present_processors);
     register_interrupt(flush_ipi, closure(h, flush_handler), "flush ipi");
     list_init(&entries);
     flush_service = closure(h, do_flush_service);
@@ -18,6 +18,10 @@
 typedef struct mm_cleaner {
     struct list l;
     mem_cleaner cleaner;
+    const char *name;
+    int cost;
+    u64 scans;          /* times asked to clean */
+    u64 cleaned;        /* bytes released */
 } *mm_cleaner;
 
 BSS_RO_AFTER_INIT filesystem root_fs;
@@ -81,7 +85,7 @@ void init_kernel_heaps(void)
                                     pagesize);
     assert(heaps.general != INVALID_ADDRESS);
 
-    heaps.locked = locking_heap_wrapper(heaps.general, heaps.general);
+    heaps.locked = locking_mcache_wrapper(heaps.general, heaps.general);
     assert(heaps.locked != INVALID_ADDRESS);
 
     u64 kmem_base = pad(bootstrap_limit, HUGE_PAGESIZE);
@@ -179,9 +183,10 @@ closure_function(2, 2, void, fsstarted,
     config_console(root);
 }
 
-/* This is very simplistic and uses a fixed drain threshold. This
-   should also take all cached data in system into account. For now we
-   just pick on the single pagecache... */
+/* Memory is reclaimed when free physical memory drops below
+   MEM_CLEAN_THRESHOLD, until MEM_CLEAN_TARGET is free again. Cleaners are
+   asked in order of increasing cost, so that idle buffers are released before
+   cached data that would have to be read again. */
 
 #ifdef MM_DEBUG
 #define mm_debug(x, ...) do {tprintf(sym(mm), 0, x, ##__VA_ARGS__);} while(0)
@@ -189,45 +194,104 @@ closure_function(2, 2, void, fsstarted,
 #define mm_debug(x, ...) do { } while(0)
 #endif
 
-static struct list mm_cleaners;
+static struct list mm_cleaners[MEM_CLEAN_COSTS];
 static struct spinlock mm_lock;
+static tuple mm_cleaners_tuple;
+static u64 mm_cleaners_count;
 
-static u64 mm_clean(u64 clean_bytes)
+/* called with mm_lock held */
+static s64 mm_clean_cost(struct list *cleaners, s64 remain)
 {
-    s64 remain = clean_bytes;
-    spin_lock(&mm_lock);
-    list end = list_end(&mm_cleaners);
+    list end = list_end(cleaners);
     list last = end->prev;
-    list e = list_begin(&mm_cleaners);
+    list e = list_begin(cleaners);
     while (e != end) {
         mm_cleaner mmc = struct_from_list(e, mm_cleaner, l);
-        remain -= apply(mmc->cleaner, remain);
+        u64 cleaned = apply(mmc->cleaner, remain);
+        mmc->scans++;
+        mmc->cleaned += cleaned;
+        mm_debug("   %s: cleaned %ld / %ld\n", mmc->name, cleaned, remain);
+        remain -= cleaned;
         if (remain <= 0)
             break;
 
         /* This cleaner couldn't satisfy the clean request: move it to the back of the list, i.e.
-         * de-prioritize it for future requests. */
+         * de-prioritize it for future requests of the same cost. */
         list next = e->next;
         list_delete(e);
-        list_push_back(&mm_cleaners, e);
+        list_push_back(cleaners, e);
 
         if (e == last)
             /* any further elements down the list are cleaners that couldn't satisfy this request */
             break;
         e = next;
     }
+    return remain;
+}
+
+static u64 mm_clean(u64 clean_bytes)
+{
+    s64 remain = clean_bytes;
+    spin_lock(&mm_lock);
+    for (int cost = 0; cost < MEM_CLEAN_COSTS && remain > 0; cost++)
+        remain = mm_clean_cost(&mm_cleaners[cost], remain);
     spin_unlock(&mm_lock);
-    return clean_bytes - remain;
+    return clean_bytes - MAX(remain, 0);
+}
+
+closure_function(2, 0, value, mm_get_scans,
+                 mm_cleaner, mmc, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(mmc)->scans);
 }
 
-boolean mm_register_mem_cleaner(mem_cleaner cleaner)
+closure_function(2, 0, value, mm_get_cleaned,
+                 mm_cleaner, mmc, value, v)
 {
-    mm_cleaner mmc = allocate(heap_locked(init_heaps), sizeof(*mmc));
+    return value_rewrite_u64(bound(v), bound(mmc)->cleaned);
+}
+
+static tuple mm_cleaner_management(heap h, mm_cleaner mmc)
+{
+    tuple t = allocate_tuple();
+    if (t == INVALID_ADDRESS)
+        return t;
+    tuple_notifier n = tuple_notifier_wrap(t);
+    if (n == INVALID_ADDRESS) {
+        destruct_tuple(t, true);
+        return INVALID_ADDRESS;
+    }
+    set(t, sym(name), buffer_cstring(h, mmc->name));
+    set(t, sym(cost), value_from_u64(h, mmc->cost));
+    value v = value_from_u64(h, 0);
+    set(t, sym(scans), v);
+    tuple_notifier_register_get_notify(n, sym(scans), closure(h, mm_get_scans, mmc, v));
+    v = value_from_u64(h, 0);
+    set(t, sym(cleaned), v);
+    tuple_notifier_register_get_notify(n, sym(cleaned), closure(h, mm_get_cleaned, mmc, v));
+    return (tuple)n;
+}
+
+boolean mm_register_mem_cleaner(mem_cleaner cleaner, const char *name, int cost)
+{
+    assert(cost >= 0 && cost < MEM_CLEAN_COSTS);
+    heap h = heap_locked(init_heaps);
+    mm_cleaner mmc = allocate(h, sizeof(*mmc));
     if (mmc == INVALID_ADDRESS)
         return false;
     mmc->cleaner = cleaner;
+    mmc->name = name;
+    mmc->cost = cost;
+    mmc->scans = 0;
+    mmc->cleaned = 0;
+    tuple t = mm_cleaner_management(h, mmc);
+    if (t == INVALID_ADDRESS) {
+        deallocate(h, mmc, sizeof(*mmc));
+        return false;
+    }
     spin_lock(&mm_lock);
-    list_push_back(&mm_cleaners, &mmc->l);
+    list_push_back(&mm_cleaners[cost], &mmc->l);
+    set(mm_cleaners_tuple, intern_u64(mm_cleaners_count++), t);
     spin_unlock(&mm_lock);
     return true;
 }
@@ -239,13 +303,22 @@ void mm_service(void)
     mm_debug("%s: total %ld, alloc %ld, free %ld\n", __func__,
              heap_total(phys), heap_allocated(phys), free);
     if (free < MEM_CLEAN_THRESHOLD) {
-        u64 clean_bytes = MEM_CLEAN_THRESHOLD - free;
+        u64 clean_bytes = MEM_CLEAN_TARGET - free;
         u64 cleaned = mm_clean(clean_bytes);
         if (cleaned > 0)
             mm_debug("   cleaned %ld / %ld requested...\n", cleaned, clean_bytes);
     }
 }
 
+void init_mm_management(tuple root)
+{
+    tuple mm = allocate_tuple();
+    assert(mm != INVALID_ADDRESS);
+    set(mm, sym(cleaners), mm_cleaners_tuple);
+    set(mm, sym(no_encode), null_value);
+    set(root, sym(mm), mm);
+}
+
 kernel_heaps get_kernel_heaps(void)
 {
     return &heaps;
@@ -365,13 +438,16 @@ void kernel_runtime_init(kernel_heaps kh)
 #endif
     init_runtime(misc, locked);
     init_sg(locked);
-    list_init(&mm_cleaners);
+    for (int cost = 0; cost < MEM_CLEAN_COSTS; cost++)
+        list_init(&mm_cleaners[cost]);
     spin_lock_init(&mm_lock);
+    mm_cleaners_tuple = allocate_tuple();
+    assert(mm_cleaners_tuple != INVALID_ADDRESS);
     init_pagecache(locked, reserve_heap_wrapper(misc, (heap)heap_linear_backed(kh), PAGECACHE_MEMORY_RESERVE),
                reserve_heap_wrapper(misc, (heap)heap_physical(kh), PAGECACHE_MEMORY_RESERVE), PAGESIZE);
     mem_cleaner pc_cleaner = closure(misc, mm_pagecache_cleaner);
     assert(pc_cleaner != INVALID_ADDRESS);
-    assert(mm_register_mem_cleaner(pc_cleaner));
+    assert(mm_register_mem_cleaner(pc_cleaner, "pagecache", MEM_CLEAN_COST_CACHE));
     unmap(0, PAGESIZE);         /* unmap zero page */
     init_extra_prints();
     init_pci(kh);
@@ -167,6 +167,7 @@ cpuinfo init_cpuinfo(heap backed, int cpu)
 
     /* state */
     ci->id = cpu;
+    ci->numa_node = numa_cpu_node(cpu);
     ci->state = cpu_not_present;
     assert(sched_queue_init(&ci->thread_queue, backed));
     ci->free_kernel_contexts = allocate_queue(backed, FREE_KERNEL_CONTEXT_QUEUE_SIZE);
@@ -175,8 +176,25 @@ cpuinfo init_cpuinfo(heap backed, int cpu)
     assert(ci->free_syscall_contexts != INVALID_ADDRESS);
     ci->cpu_queue = allocate_queue(backed, CPU_QUEUE_SIZE);
     assert(ci->cpu_queue != INVALID_ADDRESS);
+    ci->bhqueue = allocate_queue(backed, BHQUEUE_SIZE);
+    assert(ci->bhqueue != INVALID_ADDRESS);
+    ci->runqueue = allocate_queue(backed, RUNQUEUE_SIZE);
+    assert(ci->runqueue != INVALID_ADDRESS);
+    ci->async_queue_1 = allocate_queue(backed, CPU_ASYNC_QUEUE_1_SIZE);
+    assert(ci->async_queue_1 != INVALID_ADDRESS);
+    ci->timers = allocate_cpu_timers(heap_locked(get_kernel_heaps()));
+    assert(ci->timers != INVALID_ADDRESS);
     ci->last_timer_update = 0;
     ci->frcount = 0;
+    ci->idle_poll_window = 0;
+    ci->idle_halt_start = 0;
+    ci->idle_poll_hits = 0;
+    ci->idle_poll_misses = 0;
+    ci->ipi_pending = 0;
+    ci->ipi_sent = 0;
+    ci->ipi_suppressed = 0;
+    ci->fp_saves = 0;
+    ci->fp_save_bytes = 0;
     ci->mcs_prev = 0;
     ci->mcs_next = 0;
     ci->mcs_waiting = false;
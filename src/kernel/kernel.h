@@ -54,13 +54,48 @@ typedef struct kernel_context {
 
 extern boolean shutting_down;
 
+/* Scheduling classes, in increasing order of precedence. Tasks in the fair
+   and idle classes are ordered by runtime, and real-time tasks by priority
+   and then in FIFO order. */
+#define SCHED_CLASS_IDLE    0
+#define SCHED_CLASS_FAIR    1
+#define SCHED_CLASS_RT      2
+
 typedef struct sched_task {
     thunk t;
     timestamp runtime;
+    bitmap affinity;            /* CPUs allowed to run the task; 0 for any */
+    int pinned_cpu;             /* set when affinity is a single CPU, else -1 */
+    u64 migrations;
+    timestamp enqueued;         /* when made runnable; 0 while running */
+    timestamp woken;            /* when woken from a blocked state, else 0 */
+    u8 sched_class;
+    u8 rt_priority;             /* 1 (lowest) to 99, for SCHED_CLASS_RT */
+    boolean rr;                 /* round-robin among real-time tasks of equal priority */
+    timestamp rt_order;         /* place among real-time tasks of equal priority; 0 for tail */
+    timestamp rr_used;          /* time used of the current round-robin slice */
 } *sched_task;
 
+/* Bucket 0 counts intervals under 1us, bucket n intervals in [2^(n-1), 2^n)
+   us, and the last bucket all longer intervals. */
+typedef struct sched_histogram {
+    u64 buckets[SCHED_LATENCY_BUCKETS];
+} *sched_histogram;
+
+static inline void sched_histogram_record(sched_histogram sh, timestamp t)
+{
+    u64 us = usec_from_timestamp(t);
+    u64 i = us ? msb(us) + 1 : 0;
+    sh->buckets[MIN(i, SCHED_LATENCY_BUCKETS - 1)]++;
+}
+
+/* Each CPU owns a sched_queue. Tasks are ordered by runtime in q, which is
+   accessed under lock; enqueues from other CPUs go through the lock-free inbox
+   and are merged into q by the owner. Remote CPUs steal with sched_steal(),
+   which never waits on the lock. */
 typedef struct sched_queue {
     pqueue q;
+    queue inbox;
     timestamp min_runtime;
     struct spinlock lock;
 } *sched_queue;
@@ -73,10 +108,40 @@ struct cpuinfo {
     u32 id;
     int state;
     queue cpu_queue;
+    queue bhqueue;              /* kernel from interrupt */
+    queue runqueue;
+    queue async_queue_1;        /* queue of async 1 arg completions */
     struct sched_queue thread_queue;
+    timerqueue timers;          /* kernel timers registered on this cpu */
     timestamp last_timer_update;
     u64 frcount;
+
+    /* idle polling */
+    timestamp idle_poll_window;
+    timestamp idle_halt_start;  /* nonzero while idle after polling */
+    u64 idle_poll_hits;
+    u64 idle_poll_misses;
+
+    /* scheduler latency statistics, updated only by the owning cpu */
+    struct sched_histogram runq_delay;      /* runnable to running */
+    struct sched_histogram wakeup_latency;  /* woken to returning to user */
+    struct sched_histogram slice_length;    /* user time per dispatch */
+    u64 migrations;                         /* threads migrated to this cpu */
+    u32 sched_prio;                         /* of the task last dispatched */
+
+    /* wakeup IPIs */
+    u32 ipi_pending;            /* set by senders, cleared on receipt */
+    u64 ipi_sent;               /* sent from this cpu */
+    u64 ipi_suppressed;         /* not sent from this cpu: already pending */
+
+    /* extended (fp/simd) register state saved on thread switch */
+    u64 fp_saves;
+    u64 fp_save_bytes;
+
+    u32 numa_node;
+
     u64 inval_gen; /* Generation number for invalidates */
+    boolean inval_deferred;     /* full flush owed after idle */
 
     cpuinfo mcs_prev;
     cpuinfo mcs_next;
@@ -371,11 +436,14 @@ static inline boolean in_interrupt(void)
     return current_cpu()->state == cpu_interrupt;
 }
 
-extern queue bhqueue;
-extern queue runqueue;
-extern queue async_queue_1;
-extern timerqueue kernel_timers;
+/* Timers registered with the current cpu's queue are serviced by that cpu. */
+static inline timerqueue kernel_timerqueue(void)
+{
+    return current_cpu()->timers;
+}
+
 extern thunk timer_interrupt_handler;
+extern queue async_queue_1;
 
 typedef closure_type(clock_timer, void, timestamp);
 
@@ -395,15 +463,20 @@ static inline void set_platform_timer(timestamp duration)
     apply(platform_timer, duration);
 }
 
+/* Deferred work is queued on the current CPU. Bottom halves queued by an
+   interrupt that returns to a kernel or syscall context are handed off to
+   another CPU with async_apply_bh_cpu(); see bhqueue_handoff(). */
 static inline void async_apply(thunk t)
 {
     assert(!in_interrupt());
-    assert(enqueue(runqueue, t));
+    assert(enqueue(current_cpu()->runqueue, t));
 }
 
 static inline void async_apply_bh(thunk t)
 {
-    assert(enqueue_irqsafe(bhqueue, t));
+    u64 flags = irq_disable_save();
+    assert(enqueue(current_cpu()->bhqueue, t));
+    irq_restore(flags);
 }
 
 typedef closure_type(async_1, void, u64);
@@ -418,8 +491,14 @@ static inline void async_apply_1(void *a, void *arg0)
     struct applied_async_1 aa;
     aa.a = a;
     aa.arg0 = u64_from_pointer(arg0);
-    assert(enqueue_n_irqsafe(async_queue_1, &aa, sizeof(aa) / sizeof(u64)));
+    u64 flags = irq_disable_save();
+    if (!enqueue_n(current_cpu()->async_queue_1, &aa, sizeof(aa) / sizeof(u64)))
+        assert(enqueue_n(async_queue_1, &aa, sizeof(aa) / sizeof(u64)));
+    irq_restore(flags);
 }
+
+void async_apply_bh_cpu(cpuinfo ci, thunk t);
+void bhqueue_handoff(cpuinfo ci);
 #define async_apply_status_handler async_apply_1
 
 #define CONTEXT_RESUME_SPIN_LIMIT (1ull << 24)
@@ -654,8 +733,9 @@ static inline __attribute__((always_inline))  __attribute__((noreturn)) void ker
 
 static inline void schedule_timer_service(void)
 {
-    if (compare_and_swap_32(&kernel_timers->service_scheduled, false, true))
-        async_apply_bh(kernel_timers->service);
+    timerqueue tq = current_cpu()->timers;
+    if (compare_and_swap_32(&tq->service_scheduled, false, true))
+        async_apply_bh(tq->service);
 }
 
 static inline boolean is_kernel_memory(void *a)
@@ -731,6 +811,7 @@ void unmap_and_free_phys(u64 virtual, u64 length);
 
 heap allocate_tagged_region(kernel_heaps kh, u64 tag, bytes pagesize);
 heap locking_heap_wrapper(heap meta, heap parent);
+heap locking_mcache_wrapper(heap meta, heap mcache);
 
 #endif
 
@@ -763,23 +844,83 @@ void dev_irq_disable(u32 dev_id, int vector);
 #define TARGET_EXCLUSIVE_BROADCAST  (-1ull)
 
 void send_ipi(u64 cpu, u8 vector);
+void send_ipi_mask(bitmap targets, u8 vector);
 
 void init_scheduler(heap);
 void init_scheduler_cpus(heap h);
+timerqueue allocate_cpu_timers(heap h);
+void init_scheduler_management(tuple root);
 void mm_service(void);
 
 boolean sched_queue_init(sched_queue sq, heap h);
 void sched_enqueue(sched_queue sq, sched_task task);
 sched_task sched_dequeue(sched_queue sq);
+sched_task sched_steal(sched_queue sq, u64 cpu);
 u64 sched_queue_length(sched_queue sq);
+void sched_task_affinity_update(sched_task task);
+
+static inline boolean sched_task_allowed(sched_task task, u64 cpu)
+{
+    if (task->pinned_cpu >= 0)
+        return task->pinned_cpu == cpu;
+    return !task->affinity || bitmap_get(task->affinity, cpu);
+}
+
+/* Precedence of a task; a higher value preempts a lower one. */
+static inline u32 sched_task_prio(sched_task task)
+{
+    return task->sched_class == SCHED_CLASS_RT ? SCHED_CLASS_RT + task->rt_priority :
+        task->sched_class;
+}
+
+/* Change the scheduling class of a task that is not queued. */
+static inline void sched_task_set_class(sched_task task, u8 sched_class, u8 rt_priority,
+                                        boolean rr)
+{
+    if (task->sched_class != sched_class || task->rt_priority != rt_priority) {
+        task->rt_order = 0;
+        task->rr_used = 0;
+    }
+    task->sched_class = sched_class;
+    task->rt_priority = rt_priority;
+    task->rr = rr;
+}
+
+static inline cpuinfo sched_queue_cpu(sched_queue sq)
+{
+    return struct_from_field(sq, cpuinfo, thread_queue);
+}
 
 static inline boolean sched_queue_empty(sched_queue sq)
 {
     return (sched_queue_length(sq) == 0);
 }
 
+/* NUMA topology, as described by firmware */
+#define NUMA_MAX_NODES          8
+#define NUMA_MAX_RANGES         32
+#define NUMA_LOCAL_DISTANCE     10
+#define NUMA_REMOTE_DISTANCE    20
+
+extern u32 numa_nodes;
+void init_numa(heap h, int ncpus);
+int numa_node_from_domain(u32 domain, boolean create);
+void numa_add_memory(int node, range r);
+void numa_set_cpu_node(int cpu, int node);
+int numa_cpu_node(int cpu);
+void numa_set_distance(int from, int to, u8 distance);
+u8 numa_distance(int from, int to);
+u64 numa_alloc_subrange(id_heap h, bytes count, u64 start, u64 end);
+
 typedef closure_type(mem_cleaner, u64, u64);
-boolean mm_register_mem_cleaner(mem_cleaner cleaner);
+
+/* relative cost of giving memory back, cheapest cleaners are asked first */
+#define MEM_CLEAN_COST_IDLE     0   /* idle buffers and objects */
+#define MEM_CLEAN_COST_CACHE    1   /* cached data, reloaded on next use */
+#define MEM_CLEAN_COST_RESERVE  2   /* memory held back for the host */
+#define MEM_CLEAN_COSTS         3
+boolean mm_register_mem_cleaner(mem_cleaner cleaner, const char *name, int cost);
+void init_mm_management(tuple root);
 
 kernel_heaps get_kernel_heaps(void);
 
@@ -24,7 +24,7 @@ static inline u64 linear_backed_base_from_index(linear_backed_heap hb, int index
 static inline u64 linear_backed_alloc_internal(linear_backed_heap hb, bytes size)
 {
     u64 len = pad(size, hb->bh.h.pagesize);
-    u64 p = id_heap_alloc_subrange(hb->physical, len, 0, LINEAR_BACKED_PHYSLIMIT);
+    u64 p = numa_alloc_subrange(hb->physical, len, 0, LINEAR_BACKED_PHYSLIMIT);
     if (p == INVALID_PHYSICAL)
         return p;
     u64 v = virt_from_linear_backed_phys(p);
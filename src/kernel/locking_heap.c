@@ -1,6 +1,12 @@
 #include <kernel.h>
 #include <management.h>
 
+/* per-cpu stack of objects of one mcache size class */
+typedef struct heaplock_front {
+    u64 count;
+    u64 objs[MCACHE_FRONT_SIZE];
+} *heaplock_front;
+
 typedef struct heaplock {
     struct heap h;
     struct spinlock lock;
@@ -8,6 +14,9 @@ typedef struct heaplock {
     heap meta;
     tuple mgmt;
     tuple parent_mgmt;
+    heaplock_front fronts;      /* [cpu][size class], allocated once cpus are counted */
+    u64 nfronts;
+    int front_classes;          /* size classes served from front caches */
 } *heaplock;
 
 #define lock_heap(hl) u64 _flags = spin_lock_irq(&hl->lock)
@@ -30,19 +39,125 @@ static void heaplock_dealloc(heap h, u64 x, bytes size)
     unlock_heap(hl);
 }
 
+/* Called with interrupts disabled. The front caches are set up on first use
+   after the number of cpus is known; until then, the parent is used. */
+static heaplock_front heaplock_cpu_fronts(heaplock hl)
+{
+    heaplock_front fronts = hl->fronts;
+    if (!fronts) {
+        u64 n = present_processors * hl->front_classes;
+        if (n == 0)
+            return 0;
+        spin_lock(&hl->lock);
+        if (!hl->fronts) {
+            fronts = allocate_zero(hl->parent, n * sizeof(struct heaplock_front));
+            if (fronts != INVALID_ADDRESS) {
+                hl->fronts = fronts;
+                hl->nfronts = n;
+            }
+        }
+        fronts = hl->fronts;
+        spin_unlock(&hl->lock);
+        if (!fronts)
+            return 0;
+    }
+    u64 i = current_cpu()->id * hl->front_classes;
+    return i < hl->nfronts ? &fronts[i] : 0;
+}
+
+static u64 heaplock_front_alloc(heap h, bytes size)
+{
+    heaplock hl = (heaplock)h;
+    int c = mcache_size_class(hl->parent, size);
+    if (c < 0 || c >= hl->front_classes)
+        return heaplock_alloc(h, size);
+    u64 flags = irq_disable_save();
+    heaplock_front f = heaplock_cpu_fronts(hl);
+    u64 a;
+    if (!f) {
+        spin_lock(&hl->lock);
+        a = allocate_u64(hl->parent, size);
+        spin_unlock(&hl->lock);
+    } else {
+        f += c;
+        if (f->count == 0) {
+            bytes csize = mcache_class_size(hl->parent, c);
+            spin_lock(&hl->lock);
+            while (f->count < MCACHE_FRONT_SIZE / 2) {
+                a = allocate_u64(hl->parent, csize);
+                if (a == INVALID_PHYSICAL)
+                    break;
+                f->objs[f->count++] = a;
+            }
+            spin_unlock(&hl->lock);
+        }
+        a = f->count ? f->objs[--f->count] : INVALID_PHYSICAL;
+    }
+    irq_restore(flags);
+    return a;
+}
+
+static void heaplock_front_dealloc(heap h, u64 x, bytes size)
+{
+    heaplock hl = (heaplock)h;
+    /* The size only selects between parent and cache allocations; the class
+       is taken from the object itself. An object that is smaller than the
+       given size is left to the parent, which reports and leaks it. */
+    if (size != -1ull && mcache_size_class(hl->parent, size) < 0) {
+        heaplock_dealloc(h, x, size);
+        return;
+    }
+    int c = mcache_object_class(hl->parent, x);
+    if (c < 0 || c >= hl->front_classes ||
+        (size != -1ull && size > mcache_class_size(hl->parent, c))) {
+        heaplock_dealloc(h, x, size);
+        return;
+    }
+    u64 flags = irq_disable_save();
+    heaplock_front f = heaplock_cpu_fronts(hl);
+    if (!f) {
+        spin_lock(&hl->lock);
+        deallocate_u64(hl->parent, x, size);
+        spin_unlock(&hl->lock);
+    } else {
+        f += c;
+        if (f->count == MCACHE_FRONT_SIZE) {
+            bytes csize = mcache_class_size(hl->parent, c);
+            spin_lock(&hl->lock);
+            while (f->count > MCACHE_FRONT_SIZE / 2)
+                deallocate_u64(hl->parent, f->objs[--f->count], csize);
+            spin_unlock(&hl->lock);
+        }
+        f->objs[f->count++] = x;
+    }
+    irq_restore(flags);
+}
+
 /* assuming no contention on destroy */
 static void heaplock_destroy(heap h)
 {
     heaplock hl = (heaplock)h;
+    if (hl->fronts)
+        deallocate(hl->parent, hl->fronts, hl->nfronts * sizeof(struct heaplock_front));
     destroy_heap(hl->parent);
     deallocate(hl->meta, hl, sizeof(*hl));
 }
 
+/* Front cache objects are allocated from the parent but accounted as free
+   here. The sum is taken without locking and may be slightly stale. */
+static bytes heaplock_front_bytes(heaplock hl)
+{
+    bytes b = 0;
+    for (u64 i = 0; i < hl->nfronts; i++)
+        b += hl->fronts[i].count * mcache_class_size(hl->parent, i % hl->front_classes);
+    return b;
+}
+
 static bytes heaplock_allocated(heap h)
 {
     heaplock hl = (heaplock)h;
     lock_heap(hl);
-    bytes count = heap_allocated(hl->parent);
+    bytes count = heap_allocated(hl->parent) - heaplock_front_bytes(hl);
     unlock_heap(hl);
     return count;
 }
@@ -124,6 +239,22 @@ heap locking_heap_wrapper(heap meta, heap parent)
     hl->meta = meta;
     hl->mgmt = 0;
     hl->parent_mgmt = 0;
+    hl->fronts = 0;
+    hl->nfronts = 0;
+    hl->front_classes = 0;
     spin_lock_init(&hl->lock);
     return (heap)hl;
 }
+
+/* Small allocations from an mcache are served from per-cpu front caches,
+   which are refilled and flushed in batches under the lock. */
+heap locking_mcache_wrapper(heap meta, heap mcache)
+{
+    heaplock hl = (heaplock)locking_heap_wrapper(meta, mcache);
+    if (hl == INVALID_ADDRESS)
+        return INVALID_ADDRESS;
+    hl->front_classes = mcache_size_class(mcache, U64_FROM_BIT(MCACHE_FRONT_MAX_ORDER)) + 1;
+    hl->h.alloc = heaplock_front_alloc;
+    hl->h.dealloc = heaplock_front_dealloc;
+    return (heap)hl;
+}
@@ -0,0 +1,119 @@
+#include <kernel.h>
+
+//#define NUMA_DEBUG
+#ifdef NUMA_DEBUG
+#define numa_debug(x, ...) do {rprintf("NUMA: " x, ##__VA_ARGS__);} while(0)
+#else
+#define numa_debug(x, ...)
+#endif
+
+/* The topology is set up from firmware tables before secondary cpus are
+   started, and is read-only afterwards. Without a description, everything
+   belongs to node 0. */
+
+u32 numa_nodes = 1;
+
+static u32 numa_domains[NUMA_MAX_NODES];
+static u32 numa_ndomains;
+static u8 numa_distances[NUMA_MAX_NODES][NUMA_MAX_NODES];
+static boolean numa_distances_set;
+
+static struct numa_memory {
+    range r;
+    int node;
+} numa_memory[NUMA_MAX_RANGES];
+static int numa_nranges;
+
+static u8 *numa_cpu_nodes;
+static int numa_ncpus;
+
+void init_numa(heap h, int ncpus)
+{
+    numa_cpu_nodes = allocate_zero(h, ncpus);
+    assert(numa_cpu_nodes != INVALID_ADDRESS);
+    numa_ncpus = ncpus;
+}
+
+/* Maps a firmware proximity domain to a node index, optionally assigning a
+   new one. Returns -1 if the domain is unknown or there are too many. */
+int numa_node_from_domain(u32 domain, boolean create)
+{
+    for (int i = 0; i < numa_ndomains; i++) {
+        if (numa_domains[i] == domain)
+            return i;
+    }
+    if (!create)
+        return -1;
+    if (numa_ndomains == NUMA_MAX_NODES) {
+        msg_err("too many NUMA nodes, ignoring proximity domain %d\n", domain);
+        return -1;
+    }
+    numa_debug("domain %d is node %d\n", domain, numa_ndomains);
+    numa_domains[numa_ndomains] = domain;
+    numa_nodes = ++numa_ndomains;
+    return numa_nodes - 1;
+}
+
+void numa_add_memory(int node, range r)
+{
+    numa_debug("node %d: memory %R\n", node, r);
+    if (numa_nranges == NUMA_MAX_RANGES) {
+        msg_err("too many NUMA memory ranges, ignoring %R\n", r);
+        return;
+    }
+    numa_memory[numa_nranges].r = r;
+    numa_memory[numa_nranges].node = node;
+    numa_nranges++;
+}
+
+void numa_set_cpu_node(int cpu, int node)
+{
+    numa_debug("cpu %d: node %d\n", cpu, node);
+    if (!numa_cpu_nodes || cpu >= numa_ncpus)
+        return;
+    numa_cpu_nodes[cpu] = node;
+    /* cpus that have not started yet pick up their node in init_cpuinfo() */
+    cpuinfo ci = cpuinfo_from_id(cpu);
+    if (ci)
+        ci->numa_node = node;
+}
+
+int numa_cpu_node(int cpu)
+{
+    if (!numa_cpu_nodes || cpu >= numa_ncpus)
+        return 0;
+    return numa_cpu_nodes[cpu];
+}
+
+void numa_set_distance(int from, int to, u8 distance)
+{
+    numa_distances[from][to] = distance;
+    numa_distances_set = true;
+}
+
+u8 numa_distance(int from, int to)
+{
+    if (numa_distances_set && numa_distances[from][to])
+        return numa_distances[from][to];
+    return from == to ? NUMA_LOCAL_DISTANCE : NUMA_REMOTE_DISTANCE;
+}
+
+/* Allocates from memory local to the current cpu, if any fits, otherwise from
+   anywhere within [start, end). */
+u64 numa_alloc_subrange(id_heap h, bytes count, u64 start, u64 end)
+{
+    if (numa_nodes > 1) {
+        int node = current_cpu()->numa_node;
+        for (int i = 0; i < numa_nranges; i++) {
+            if (numa_memory[i].node != node)
+                continue;
+            range r = range_intersection(numa_memory[i].r, irange(start, end));
+            if (range_span(r) < count)
+                continue;
+            u64 p = id_heap_alloc_subrange(h, count, r.start, r.end);
+            if (p != INVALID_PHYSICAL)
+                return p;
+        }
+    }
+    return id_heap_alloc_subrange(h, count, start, end);
+}
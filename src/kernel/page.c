@@ -207,6 +207,76 @@ boolean validate_virtual_writable(void * base, u64 length)
     return traverse_ptes(u64_from_pointer(base), length, stack_closure(validate_entry_writable));
 }
 
+/* called with lock held */
+closure_function(2, 3, boolean, split_block_entry,
+                 u64, boundary, flush_entry, fe,
+                 int, level, u64, vaddr, pteptr, entry)
+{
+    pte e = pte_from_pteptr(entry);
+    int order = pte_order(level, e);
+    if (level == PT_PTE_LEVEL || order == 0 || (bound(boundary) & MASK(order)) == 0)
+        return true;
+
+    /* replace the block with a table of smaller mappings of the same pages */
+    u64 tp_phys;
+    u64 *tp = allocate_table_page(&tp_phys);
+    if (tp == INVALID_ADDRESS) {
+        msg_err("failed to allocate page table memory\n");
+        return false;
+    }
+    u64 phys = page_from_pte(e);
+    u64 flags = flags_from_pte(e);
+    int shift = pt_level_shift(level + 1);
+    for (int i = 0; i < PTE_ENTRIES; i++) {
+        u64 p = phys + ((u64)i << shift);
+        tp[i] = (level + 1 == PT_PTE_LEVEL) ? page_pte(p, flags) : block_pte(p, flags);
+    }
+    pte_set(entry, new_level_pte(tp_phys));
+    page_invalidate(bound(fe), vaddr);
+    return true;
+}
+
+/* Split any block mappings straddling the start or end of a range, so that
+   the range can be unmapped or updated without affecting its neighbors. */
+static void split_block_boundaries(u64 vaddr, u64 length, flush_entry fe)
+{
+    u64 end = vaddr + length;
+    traverse_ptes(vaddr, PAGESIZE, stack_closure(split_block_entry, vaddr, fe));
+    traverse_ptes(end, PAGESIZE, stack_closure(split_block_entry, end, fe));
+}
+
+/* called with lock held */
+closure_function(2, 3, boolean, check_unmapped_entry,
+                 u64, order, boolean *, empty,
+                 int, level, u64, vaddr, pteptr, entry)
+{
+    pte e = pte_from_pteptr(entry);
+    if (pte_is_present(e) &&
+        (pte_is_mapping(level, e) || pt_level_shift(level) <= bound(order))) {
+        *bound(empty) = false;
+        return false;
+    }
+    return true;
+}
+
+/* called with lock held */
+static boolean map_range_is_empty_locked(u64 vaddr, u64 length)
+{
+    boolean empty = true;
+    recurse_ptes(get_pagetable_base(vaddr), PT_FIRST_LEVEL, vaddr, length, 0,
+                 stack_closure(check_unmapped_entry, find_order(length), &empty));
+    return empty;
+}
+
+/* vaddr and length must be aligned to a mapping size */
+boolean map_range_is_empty(u64 vaddr, u64 length)
+{
+    pagetable_lock();
+    boolean empty = map_range_is_empty_locked(vaddr, length);
+    pagetable_unlock();
+    return empty;
+}
+
 /* called with lock held */
 closure_function(2, 3, boolean, update_pte_flags,
                  pageflags, flags, flush_entry, fe,
@@ -235,6 +305,7 @@ void update_map_flags_with_complete(u64 vaddr, u64 length, pageflags flags, stat
     /* Catch any attempt to change page flags in a linear_backed mapping */
     assert(!intersects_linear_backed(irangel(vaddr, length)));
     flush_entry fe = get_page_flush_entry();
+    split_block_boundaries(vaddr, length, fe);
     traverse_ptes(vaddr, length, stack_closure(update_pte_flags, flags, fe));
     page_invalidate_sync(fe, complete);
 #ifdef PAGE_DUMP_ALL
@@ -294,6 +365,7 @@ void remap_pages(u64 vaddr_new, u64 vaddr_old, u64 length)
     assert(range_empty(range_intersection(irange(vaddr_new, vaddr_new + length),
                                           irange(vaddr_old, vaddr_old + length))));
     flush_entry fe = get_page_flush_entry();
+    split_block_boundaries(vaddr_old, length, fe);
     traverse_ptes(vaddr_old, length, stack_closure(remap_entry, vaddr_new, vaddr_old, fe));
     page_invalidate_sync(fe, 0);
 #ifdef PAGE_DUMP_ALL
@@ -345,13 +417,15 @@ closure_function(2, 3, boolean, unmap_page,
 }
 
 /* Be warned: the page table lock is held when rh is called; don't try
-   to modify the page table while traversing it */
-void unmap_pages_with_handler(u64 virtual, u64 length, range_handler rh)
+   to modify the page table while traversing it. The complete handler, if
+   any, is applied once all cpus have invalidated the unmapped pages. */
+void unmap_pages_with_complete(u64 virtual, u64 length, range_handler rh, status_handler complete)
 {
     assert(!((virtual & PAGEMASK) || (length & PAGEMASK)));
     flush_entry fe = get_page_flush_entry();
+    split_block_boundaries(virtual, length, fe);
     traverse_ptes(virtual, length, stack_closure(unmap_page, rh, fe));
-    page_invalidate_sync(fe, 0);
+    page_invalidate_sync(fe, complete);
 #ifdef PAGE_DUMP_ALL
     early_debug("unmap ");
     dump_page_tables(virtual, length);
@@ -492,6 +566,7 @@ physical map_with_complete(u64 v, physical p, u64 length, pageflags flags, statu
     assert((v & PAGEMASK) == 0);
     assert((p & PAGEMASK) == 0);
     range r = irangel(v, pad(length, PAGESIZE));
+    flags = pageflags_for_address(flags, v);
     pagetable_lock();
     u64 *table_ptr = pointer_from_pteaddr(get_pagetable_base(v));
     if (!map_level(table_ptr, PT_FIRST_LEVEL, r, &p, flags.w, 0)) {
@@ -512,9 +587,34 @@ physical map_with_complete(u64 v, physical p, u64 length, pageflags flags, statu
     return p - length;
 }
 
+/* Map a block only if nothing is mapped within it, including through a lower-level table; the
+ * check and the mapping are done under the page table lock. Returns false without touching the
+ * page tables if the range is not empty or if page table memory cannot be allocated. v, p and
+ * length must be aligned to a mapping size. */
+boolean map_block_if_empty(u64 v, physical p, u64 length, pageflags flags, status_handler complete)
+{
+    assert((v & MASK(find_order(length))) == 0);
+    assert((p & MASK(find_order(length))) == 0);
+    range r = irangel(v, length);
+    flags = pageflags_for_address(flags, v);
+    pagetable_lock();
+    if (!map_range_is_empty_locked(v, length)) {
+        pagetable_unlock();
+        return false;
+    }
+    u64 *table_ptr = pointer_from_pteaddr(get_pagetable_base(v));
+    /* With the range empty, a failure can only occur before any entry is installed. */
+    boolean mapped = map_level(table_ptr, PT_FIRST_LEVEL, r, &p, flags.w, 0);
+    pagetable_unlock();
+    if (mapped && complete)
+        apply(complete, STATUS_OK);
+    return mapped;
+}
+
 void remap(u64 v, physical p, u64 length, pageflags flags)
 {
     range r = irangel(v, pad(length, PAGESIZE));
+    flags = pageflags_for_address(flags, v);
     flush_entry fe = get_page_flush_entry();
     pagetable_lock();
     u64 *table_ptr = pointer_from_pteaddr(get_pagetable_base(v));
@@ -29,6 +29,7 @@ void page_invalidate_flush();
 
 void invalidate(u64 page);
 void flush_tlb(boolean full_flush);
+void flush_tlb_user(void);
 
 /* mapping and flag update */
 physical map_with_complete(u64 v, physical p, u64 length, pageflags flags, status_handler complete);
@@ -45,13 +46,21 @@ static inline void update_map_flags(u64 vaddr, u64 length, pageflags flags)
     update_map_flags_with_complete(vaddr, length, flags, 0);
 }
 
+boolean map_block_if_empty(u64 v, physical p, u64 length, pageflags flags, status_handler complete);
+
 /* overwrite any existing mappings in the virtual address range */
 void remap(u64 v, physical p, u64 length, pageflags flags);
 
 void zero_mapped_pages(u64 vaddr, u64 length);
 void remap_pages(u64 vaddr_new, u64 vaddr_old, u64 length);
 void unmap(u64 virtual, u64 length);
-void unmap_pages_with_handler(u64 virtual, u64 length, range_handler rh);
+void unmap_pages_with_complete(u64 virtual, u64 length, range_handler rh, status_handler complete);
+boolean map_range_is_empty(u64 vaddr, u64 length);
+
+static inline void unmap_pages_with_handler(u64 virtual, u64 length, range_handler rh)
+{
+    unmap_pages_with_complete(virtual, length, rh, 0);
+}
 
 static inline void unmap_pages(u64 virtual, u64 length)
 {
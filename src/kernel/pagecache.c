@@ -1633,7 +1633,7 @@ pagecache_volume pagecache_allocate_volume(u64 length, int block_order)
     spin_lock_init(&pv->lock);
     if (!timer_is_active(&pc->scan_timer)) {
         timestamp t = seconds(PAGECACHE_SCAN_PERIOD_SECONDS);
-        register_timer(kernel_timers, &pc->scan_timer, CLOCK_ID_MONOTONIC, t, false, t,
+        register_timer(kernel_timerqueue(), &pc->scan_timer, CLOCK_ID_MONOTONIC, t, false, t,
                        (timer_handler)&pc->do_scan_timer);
     }
 #endif
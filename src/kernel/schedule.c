@@ -20,14 +20,79 @@ BSS_RO_AFTER_INIT static int wakeup_vector;
 BSS_RO_AFTER_INIT int shutdown_vector;
 boolean shutting_down;
 
-BSS_RO_AFTER_INIT queue bhqueue;                  /* kernel from interrupt */
-BSS_RO_AFTER_INIT queue runqueue;
-BSS_RO_AFTER_INIT queue async_queue_1;            /* queue of async 1 arg completions */
+BSS_RO_AFTER_INIT queue async_queue_1;            /* overflow of per-cpu async queues */
 BSS_RO_AFTER_INIT bitmap idle_cpu_mask;
 
-BSS_RO_AFTER_INIT timerqueue kernel_timers;
+/* targets of wakeup_or_interrupt_cpu_all() */
+BSS_RO_AFTER_INIT static bitmap ipi_all_mask;
+static struct spinlock ipi_all_lock;
+
 BSS_RO_AFTER_INIT thunk timer_interrupt_handler;
 
+/* maximum idle polling window; polling is disabled if zero */
+static timestamp idle_poll_max;
+
+static inline boolean deferred_work_pending(cpuinfo ci)
+{
+    return !queue_empty(ci->bhqueue) || !queue_empty(ci->async_queue_1) ||
+        !queue_empty(ci->runqueue);
+}
+
+static inline boolean shared_work_pending(void)
+{
+    return !queue_empty(async_queue_1);
+}
+
+static inline boolean runloop_work_pending(cpuinfo ci)
+{
+    return !queue_empty(ci->cpu_queue) || deferred_work_pending(ci) ||
+        shared_work_pending() || (!shutting_down && !sched_queue_empty(&ci->thread_queue));
+}
+
+/* Spin for up to the current polling window waiting for work to arrive, so
+   that work which shows up shortly after the runloop goes idle can be picked
+   up without a halt and wakeup IPI. The CPU is not marked in idle_cpu_mask
+   while polling, so enqueuers don't send IPIs; interrupts are enabled and
+   are handled the same as they would be while halted. */
+NOTRACE static boolean idle_poll(cpuinfo ci)
+{
+    timestamp start = now(CLOCK_ID_MONOTONIC_RAW);
+    timestamp window = ci->idle_poll_window;
+    ci->idle_halt_start = start;
+    if (window == 0)
+        return false;
+    enable_interrupts();
+    do {
+        if (runloop_work_pending(ci)) {
+            disable_interrupts();
+            ci->idle_poll_hits++;
+            ci->idle_halt_start = 0;
+            return true;
+        }
+        kern_pause();
+    } while (now(CLOCK_ID_MONOTONIC_RAW) - start < window);
+    disable_interrupts();
+    ci->idle_poll_misses++;
+    return false;
+}
+
+/* Adjust the polling window after a halt: grow it if the CPU was woken up
+   within the maximum window (polling longer would have avoided the halt),
+   shrink it if the CPU stayed idle for longer than that. */
+static void idle_poll_adjust(cpuinfo ci, timestamp idle_time)
+{
+    timestamp window = ci->idle_poll_window;
+    if (idle_time <= idle_poll_max) {
+        window = window ? window * IDLE_POLL_GROW_FACTOR : microseconds(IDLE_POLL_START_US);
+        window = MIN(window, idle_poll_max);
+    } else {
+        window /= IDLE_POLL_SHRINK_FACTOR;
+        if (window < microseconds(IDLE_POLL_START_US))
+            window = 0;
+    }
+    ci->idle_poll_window = window;
+}
+
 NOTRACE void __attribute__((noreturn)) kernel_sleep(void)
 {
     // we're going to cover up this race by checking the state in the interrupt
@@ -35,51 +100,151 @@ NOTRACE void __attribute__((noreturn)) kernel_sleep(void)
     cpuinfo ci = current_cpu();
     sched_debug("sleep\n");
     ci->state = cpu_idle;
+    if (idle_poll_max && idle_poll(ci))
+        runloop();
     bitmap_set_atomic(idle_cpu_mask, ci->id, 1);
 
+    /* Pick up work enqueued before the idle bit became visible. */
+    if (runloop_work_pending(ci)) {
+        bitmap_set_atomic(idle_cpu_mask, ci->id, 0);
+        ci->idle_halt_start = 0;
+        runloop();
+    }
+
     while (1) {
         wait_for_interrupt();
     }
 }
 
+/* A wakeup IPI already in flight to the target will make it check for work
+   after clearing ipi_pending, so there is no need to send another. */
+static boolean wakeup_ipi_claim(cpuinfo ci, cpuinfo target)
+{
+    if (compare_and_swap_32(&target->ipi_pending, 0, 1)) {
+        ci->ipi_sent++;
+        return true;
+    }
+    ci->ipi_suppressed++;
+    return false;
+}
+
+static void send_wakeup_ipi(cpuinfo target)
+{
+    if (wakeup_ipi_claim(current_cpu(), target))
+        send_ipi(target->id, wakeup_vector);
+}
+
+closure_function(0, 0, void, wakeup_ipi_handler)
+{
+    atomic_swap_32(&current_cpu()->ipi_pending, 0);
+}
+
 void wakeup_or_interrupt_cpu_all()
 {
     cpuinfo ci = current_cpu();
+    u64 flags = spin_lock_irq(&ipi_all_lock);
+    bitmap_range_check_and_set(ipi_all_mask, 0, total_processors, false, false);
+    boolean send = false;
     for (int i = 0; i < total_processors; i++) {
         if (i != ci->id) {
             bitmap_set_atomic(idle_cpu_mask, i, 0);
-            send_ipi(i, wakeup_vector);
+            if (wakeup_ipi_claim(ci, cpuinfo_from_id(i))) {
+                bitmap_set(ipi_all_mask, i, 1);
+                send = true;
+            }
         }
     }
+    if (send)
+        send_ipi_mask(ipi_all_mask, wakeup_vector);
+    spin_unlock_irq(&ipi_all_lock, flags);
 }
 
 static void wakeup_cpu(u64 cpu)
 {
     if (bitmap_test_and_set_atomic(idle_cpu_mask, cpu, 0)) {
         sched_debug("waking up CPU %d\n", cpu);
-        send_ipi(cpu, wakeup_vector);
+        send_wakeup_ipi(cpuinfo_from_id(cpu));
+    }
+}
+
+/* Queue a bottom half on another cpu. A cpu running a user thread only
+   checks its queues on the next interrupt, so it is sent a wakeup IPI as well. */
+void async_apply_bh_cpu(cpuinfo ci, thunk t)
+{
+    assert(enqueue_irqsafe(ci->bhqueue, t));
+    if (ci == current_cpu())
+        return;
+    if (ci->state == cpu_user)
+        send_wakeup_ipi(ci);
+    else
+        wakeup_cpu(ci->id);
+}
+
+/* An idle cpu is preferred, then one running a user thread, as either will
+   service its queues right away once signaled. */
+static cpuinfo bhqueue_handoff_target(cpuinfo ci)
+{
+    u64 cpu = bitmap_range_get_first(idle_cpu_mask, 0, total_processors);
+    if (cpu != INVALID_PHYSICAL && cpu != ci->id)
+        return cpuinfo_from_id(cpu);
+    for (cpu = 0; cpu < total_processors; cpu++) {
+        cpuinfo cpui = cpuinfo_from_id(cpu);
+        if (cpui != ci && cpui->state == cpu_user)
+            return cpui;
     }
+    return cpuinfo_from_id((ci->id + 1) % total_processors);
 }
 
-static sched_task migrate_to_self(sched_task t, u64 first_cpu, u64 ncpus)
+/* Called with interrupts disabled before an interrupt returns directly to a
+   kernel or syscall context, which doesn't pass through the runloop. Bottom
+   halves queued by the interrupt would otherwise wait for that context to
+   finish, which may in turn be waiting on them (e.g. a context spinning for
+   a flush entry while the flush service sits in this queue). */
+void bhqueue_handoff(cpuinfo ci)
+{
+    if (queue_empty(ci->bhqueue) || total_processors == 1)
+        return;
+    cpuinfo target = bhqueue_handoff_target(ci);
+    sched_debug("handing off bottom halves to CPU %d\n", target->id);
+    thunk t;
+    while ((t = dequeue(ci->bhqueue)) != INVALID_ADDRESS)
+        async_apply_bh_cpu(target, t);
+}
+
+/* If node is not negative, only cpus on that node are considered. */
+static sched_task migrate_to_self(sched_task t, u64 first_cpu, u64 ncpus, int node)
 {
     u64 cpu;
     while ((ncpus > 0) &&
             ((cpu = bitmap_range_get_first(idle_cpu_mask, first_cpu, ncpus)) != INVALID_PHYSICAL)) {
         cpuinfo cpui = cpuinfo_from_id(cpu);
+        ncpus -= cpu - first_cpu + 1;
+        first_cpu = cpu + 1;
+        if (node >= 0 && cpui->numa_node != node)
+            continue;
         if (t == INVALID_ADDRESS) {
-            t = sched_dequeue(&cpui->thread_queue);
+            t = sched_steal(&cpui->thread_queue, current_cpu()->id);
             if (t != INVALID_ADDRESS)
                 sched_debug("migrating thread from idle CPU %d to self\n", cpu);
         }
-        if ((t != INVALID_ADDRESS) && !sched_queue_empty(&cpui->thread_queue))
+        /* Wake up the CPU if it has threads left, including any that could
+           not be stolen because of their affinity. */
+        if (!sched_queue_empty(&cpui->thread_queue))
             wakeup_cpu(cpu);
-        ncpus -= cpu - first_cpu + 1;
-        first_cpu = cpu + 1;
     }
     return t;
 }
 
+static sched_task migrate_from_idle(cpuinfo ci, int node)
+{
+    sched_task t = INVALID_ADDRESS;
+    if (ci->id + 1 < total_processors)
+        t = migrate_to_self(t, ci->id + 1, total_processors - ci->id - 1, node);
+    if (ci->id > 0)
+        t = migrate_to_self(t, 0, ci->id, node);
+    return t;
+}
+
 static void migrate_from_self(cpuinfo ci, u64 first_cpu, u64 ncpus)
 {
     u64 cpu;
@@ -89,7 +254,7 @@ static void migrate_from_self(cpuinfo ci, u64 first_cpu, u64 ncpus)
         sched_task task;
         if (!sched_queue_empty(&cpui->thread_queue)) {
             wakeup_cpu(cpu);
-        } else if ((task = sched_dequeue(&ci->thread_queue)) != INVALID_ADDRESS) {
+        } else if ((task = sched_steal(&ci->thread_queue, cpu)) != INVALID_ADDRESS) {
             sched_debug("migrating thread from self to idle CPU %d\n", cpu);
             sched_enqueue(&cpui->thread_queue, task);
             wakeup_cpu(cpu);
@@ -99,24 +264,60 @@ static void migrate_from_self(cpuinfo ci, u64 first_cpu, u64 ncpus)
     }
 }
 
-static inline boolean update_timer(timestamp here)
+/* The busiest cpu is looked for among the nearest ones first. */
+static sched_task migrate_from_busiest(cpuinfo ci)
+{
+    cpuinfo busiest = 0;
+    u64 max_queued = 0;
+    u8 min_distance = 0;
+    for (u64 cpu = ci->id + 1; ; cpu++) {
+        if (cpu == total_processors)
+            cpu = 0;
+        if (cpu == ci->id)
+            break;
+        cpuinfo cpui = cpuinfo_from_id(cpu);
+        if (cpui->state != cpu_user)
+            continue;
+        u64 queued = sched_queue_length(&cpui->thread_queue);
+        if (queued == 0)
+            continue;
+        u8 distance = numa_distance(ci->numa_node, cpui->numa_node);
+        if (!busiest || distance < min_distance ||
+            (distance == min_distance && queued > max_queued)) {
+            busiest = cpui;
+            max_queued = queued;
+            min_distance = distance;
+        }
+    }
+    if (!busiest)
+        return INVALID_ADDRESS;
+    sched_task t = sched_steal(&busiest->thread_queue, ci->id);
+    if (t != INVALID_ADDRESS)
+        sched_debug("migrating thread from CPU %d to self\n", busiest->id);
+    return t;
+}
+
+static inline boolean update_timer(cpuinfo ci, timestamp here)
 {
-    timestamp next = kernel_timers->next_expiry;
-    if (!compare_and_swap_32(&kernel_timers->update, true, false))
+    timerqueue tq = ci->timers;
+    timestamp next = tq->next_expiry;
+    if (!compare_and_swap_32(&tq->update, true, false))
         return false;
     s64 delta = next - here;
-    timestamp timeout = delta > (s64)kernel_timers->min ? MIN(delta, kernel_timers->max) : kernel_timers->min;
+    timestamp timeout = delta > (s64)tq->min ? MIN(delta, tq->max) : tq->min;
     sched_debug("set platform timer: delta %lx, timeout %lx\n", delta, timeout);
-    current_cpu()->last_timer_update = next + timeout - delta;
+    ci->last_timer_update = next + timeout - delta;
     set_platform_timer(timeout);
     return true;
 }
 
-closure_function(0, 0, void, kernel_timers_service)
+closure_function(1, 0, void, kernel_timers_service,
+                 timerqueue, tq)
 {
     /* timer_service() should be reentrant, so we don't take a lock here */
-    kernel_timers->service_scheduled = false;
-    timer_service(kernel_timers, now(CLOCK_ID_MONOTONIC_RAW));
+    timerqueue tq = bound(tq);
+    tq->service_scheduled = false;
+    timer_service(tq, now(CLOCK_ID_MONOTONIC_RAW));
 }
 
 closure_function(0, 0, void, timer_interrupt_handler_fn)
@@ -158,9 +359,13 @@ NOTRACE void __attribute__((noreturn)) runloop_internal(void)
     disable_interrupts();
     sched_debug("runloop from %s c: %d  a1: %d b:%d  r:%d  t:%d\n",
                 state_strings[ci->state], queue_length(ci->cpu_queue),
-                queue_length(async_queue_1), queue_length(bhqueue),
-                queue_length(runqueue), sched_queue_length(&ci->thread_queue));
+                queue_length(ci->async_queue_1), queue_length(ci->bhqueue),
+                queue_length(ci->runqueue), sched_queue_length(&ci->thread_queue));
     ci->state = cpu_kernel;
+    if (ci->idle_halt_start) {
+        idle_poll_adjust(ci, now(CLOCK_ID_MONOTONIC_RAW) - ci->idle_halt_start);
+        ci->idle_halt_start = 0;
+    }
     /* Make sure TLB entries are appropriately flushed before doing any work */
     page_invalidate_flush();
 
@@ -169,46 +374,35 @@ NOTRACE void __attribute__((noreturn)) runloop_internal(void)
     service_thunk_queue(ci->cpu_queue);
 
     /* bhqueue is for deferred operations, enqueued by interrupt handlers */
-    service_thunk_queue(bhqueue);
+    service_thunk_queue(ci->bhqueue);
 
     /* serve deferred status_handlers, some of which may not return */
+    service_async_1(ci->async_queue_1);
     service_async_1(async_queue_1);
 
-    service_thunk_queue(runqueue);
+    service_thunk_queue(ci->runqueue);
 
     /* should be a list of per-runloop checks - also low-pri background */
     mm_service();
 
     timestamp here = now(CLOCK_ID_MONOTONIC_RAW);
-    boolean timer_updated = update_timer(here);
+    boolean timer_updated = update_timer(ci, here);
 
     if (!shutting_down) {
         sched_task t = sched_dequeue(&ci->thread_queue);
         if (t == INVALID_ADDRESS) {
             /* Try to steal a thread from an idle CPU (so that it doesn't
              * have to be woken up), and wake up CPUs that have a non-empty
-             * thread queue). */
-            if (ci->id + 1 < total_processors)
-                t = migrate_to_self(t, ci->id + 1, total_processors - ci->id - 1);
-            if (ci->id > 0)
-                t = migrate_to_self(t, 0, ci->id);
+             * thread queue). CPUs on the same NUMA node are tried first. */
+            if (numa_nodes > 1)
+                t = migrate_from_idle(ci, ci->numa_node);
+            if (t == INVALID_ADDRESS)
+                t = migrate_from_idle(ci, -1);
             if (t == INVALID_ADDRESS) {
-                /* No threads found in idle CPUs: try to steal a thread from a
-                 * CPU that is currently running another thread. */
-                for (u64 cpu = ci->id + 1; ; cpu++) {
-                    if (cpu == total_processors)
-                        cpu = 0;
-                    if (cpu == ci->id)
-                        break;
-                    cpuinfo cpui = cpuinfo_from_id(cpu);
-                    if (cpui->state == cpu_user) {
-                        t = sched_dequeue(&cpui->thread_queue);
-                        if (t != INVALID_ADDRESS) {
-                            sched_debug("migrating thread from CPU %d to self\n", cpu);
-                            break;
-                        }
-                    }
-                }
+                /* No threads found in idle CPUs: try to steal a thread from
+                 * the most loaded CPU that is currently running another
+                 * thread. */
+                t = migrate_from_busiest(ci);
             }
         } else {
             /* Wake up idle CPUs that have a non-empty thread queue, and if our
@@ -219,17 +413,25 @@ NOTRACE void __attribute__((noreturn)) runloop_internal(void)
                 migrate_from_self(ci, 0, ci->id);
         }
         if (t != INVALID_ADDRESS) {
-            if (!timer_updated) {
+            sched_histogram_record(&ci->runq_delay, here > t->enqueued ? here - t->enqueued : 0);
+            t->enqueued = 0;
+            ci->sched_prio = sched_task_prio(t);
+
+            /* A round-robin task runs for at most the rest of its slice. */
+            timestamp slice = ci->timers->max;
+            if (t->sched_class == SCHED_CLASS_RT && t->rr)
+                slice = MIN(slice, microseconds(SCHED_RR_TIMESLICE_US) - t->rr_used);
+            if (!timer_updated || slice < ci->timers->max) {
                 /* Before we schedule a thread on this CPU, we want to be sure
-                   that a timer will fire on this core within the interval
-                   kernel_timers->max into the future. Taking the place of a
-                   true time quantum per thread, this acts to prevent a thread
-                   from running for too long and starving out other threads. */
+                   that a timer will fire on this core within the slice
+                   interval into the future. Taking the place of a true time
+                   quantum per thread, this acts to prevent a thread from
+                   running for too long and starving out other threads. */
                 s64 timeout = ci->last_timer_update - here;
-                if (kernel_timers->empty || (timeout > (s64)kernel_timers->max)) {
+                if (ci->timers->empty || (timeout > (s64)slice)) {
                     sched_debug("setting CPU scheduler timer\n");
-                    set_platform_timer(kernel_timers->max);
-                    ci->last_timer_update = here + kernel_timers->max;
+                    set_platform_timer(slice);
+                    ci->last_timer_update = here + slice;
                 }
             }
             apply(t->t);
@@ -237,12 +439,10 @@ NOTRACE void __attribute__((noreturn)) runloop_internal(void)
     }
 
     /* We want to pick up items that were enqueued during this last pass, else
-       runnable items may get stuck waiting for the next interrupt.
-
-       Find cost of sleep / wakeup and consider spinning this check for that interval. */
-    if (queue_length(ci->cpu_queue) || queue_length(async_queue_1) ||
-        queue_length(bhqueue) || queue_length(runqueue) ||
-        (!shutting_down && !sched_queue_empty(&ci->thread_queue)))
+       runnable items may get stuck waiting for the next interrupt. If idle
+       polling is enabled, kernel_sleep() spins on this check for an adaptive
+       interval before halting. */
+    if (runloop_work_pending(ci))
         goto retry;
 
     kernel_sleep();
@@ -259,27 +459,35 @@ closure_function(0, 0, void, global_shutdown)
     machine_halt();
 }
 
+timerqueue allocate_cpu_timers(heap h)
+{
+    timerqueue tq = allocate_timer_wheel(h, 0, KERNEL_TIMER_WHEEL_TICK_ORDER, "runloop");
+    if (tq == INVALID_ADDRESS)
+        return tq;
+    tq->min = microseconds(RUNLOOP_TIMER_MIN_PERIOD_US);
+    tq->max = microseconds(RUNLOOP_TIMER_MAX_PERIOD_US);
+    tq->service = closure(h, kernel_timers_service, tq);
+    if (tq->service == INVALID_ADDRESS) {
+        deallocate_timerqueue(tq);
+        return INVALID_ADDRESS;
+    }
+    return tq;
+}
+
 void init_scheduler(heap h)
 {
-    /* timer init */
-    kernel_timers = allocate_timerqueue(h, 0, "runloop");
-    assert(kernel_timers != INVALID_ADDRESS);
-    kernel_timers->min = microseconds(RUNLOOP_TIMER_MIN_PERIOD_US);
-    kernel_timers->max = microseconds(RUNLOOP_TIMER_MAX_PERIOD_US);
-    kernel_timers->service = closure(h, kernel_timers_service);
     timer_interrupt_handler = closure(h, timer_interrupt_handler_fn);
 
     /* IPI init */
     wakeup_vector = allocate_ipi_interrupt();
-    register_interrupt(wakeup_vector, ignore, "wakeup ipi");
+    register_interrupt(wakeup_vector, closure(h, wakeup_ipi_handler), "wakeup ipi");
     shutdown_vector = allocate_ipi_interrupt();
     register_interrupt(shutdown_vector, closure(h, global_shutdown), "shutdown ipi");
     assert(wakeup_vector != INVALID_PHYSICAL);
 
-    /* scheduling queues init */
-    bhqueue = allocate_queue(h, BHQUEUE_SIZE);
-    runqueue = allocate_queue(h, RUNQUEUE_SIZE);
+    /* shared overflow of per-cpu async queues */
     async_queue_1 = allocate_queue(h, ASYNC_QUEUE_1_SIZE);
+    assert(async_queue_1 != INVALID_ADDRESS);
     shutting_down = false;
 }
 
@@ -288,11 +496,153 @@ void init_scheduler_cpus(heap h)
     idle_cpu_mask = allocate_bitmap(h, h, present_processors);
     assert(idle_cpu_mask != INVALID_ADDRESS);
     bitmap_alloc(idle_cpu_mask, present_processors);
+    ipi_all_mask = allocate_bitmap(h, h, present_processors);
+    assert(ipi_all_mask != INVALID_ADDRESS);
+    bitmap_alloc(ipi_all_mask, present_processors);
+    spin_lock_init(&ipi_all_lock);
+}
+
+closure_function(0, 1, boolean, idle_poll_notify,
+                 value, v)
+{
+    u64 max_us;
+    if (!v)
+        max_us = 0;
+    else if (!u64_from_value(v, &max_us))
+        max_us = IDLE_POLL_DEFAULT_MAX_US;
+    idle_poll_max = microseconds(max_us);
+    return true;
+}
+
+#define register_cpu_stat(ci, n, t, name)                               \
+    v = value_from_u64(h, 0);                                           \
+    s = sym(name);                                                      \
+    set(t, s, v);                                                       \
+    tuple_notifier_register_get_notify(n, s, closure(h, sched_get_ ##name, ci, v));
+
+closure_function(2, 0, value, sched_get_idle_poll_window_us,
+                 cpuinfo, ci, value, v)
+{
+    return value_rewrite_u64(bound(v), usec_from_timestamp(bound(ci)->idle_poll_window));
+}
+
+closure_function(2, 0, value, sched_get_idle_poll_hits,
+                 cpuinfo, ci, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(ci)->idle_poll_hits);
+}
+
+closure_function(2, 0, value, sched_get_idle_poll_misses,
+                 cpuinfo, ci, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(ci)->idle_poll_misses);
+}
+
+closure_function(2, 0, value, sched_get_ipi_sent,
+                 cpuinfo, ci, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(ci)->ipi_sent);
+}
+
+closure_function(2, 0, value, sched_get_ipi_suppressed,
+                 cpuinfo, ci, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(ci)->ipi_suppressed);
+}
+
+closure_function(2, 0, value, sched_get_fp_saves,
+                 cpuinfo, ci, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(ci)->fp_saves);
+}
+
+closure_function(2, 0, value, sched_get_fp_save_bytes,
+                 cpuinfo, ci, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(ci)->fp_save_bytes);
+}
+
+closure_function(2, 0, value, sched_get_migrations,
+                 cpuinfo, ci, value, v)
+{
+    return value_rewrite_u64(bound(v), bound(ci)->migrations);
+}
+
+/* histograms are presented as a list of bucket counts */
+closure_function(2, 0, value, sched_get_histogram,
+                 sched_histogram, sh, value, v)
+{
+    buffer b = (buffer)bound(v);
+    buffer_clear(b);
+    for (int i = 0; i < SCHED_LATENCY_BUCKETS; i++) {
+        if (i > 0)
+            push_u8(b, ' ');
+        print_number(b, bound(sh)->buckets[i], 10, 0);
+    }
+    return b;
+}
+
+#define register_cpu_histogram(ci, n, t, name)                          \
+    v = value_from_u64(h, 0);                                           \
+    s = sym(name);                                                      \
+    set(t, s, v);                                                       \
+    tuple_notifier_register_get_notify(n, s, closure(h, sched_get_histogram, &ci->name, v));
+
+static tuple sched_cpu_management(heap h, cpuinfo ci)
+{
+    value v;
+    symbol s;
+    tuple t = allocate_tuple();
+    assert(t != INVALID_ADDRESS);
+    tuple_notifier n = tuple_notifier_wrap(t);
+    assert(n != INVALID_ADDRESS);
+    register_cpu_stat(ci, n, t, idle_poll_window_us);
+    register_cpu_stat(ci, n, t, idle_poll_hits);
+    register_cpu_stat(ci, n, t, idle_poll_misses);
+    register_cpu_stat(ci, n, t, migrations);
+    register_cpu_stat(ci, n, t, ipi_sent);
+    register_cpu_stat(ci, n, t, ipi_suppressed);
+    register_cpu_stat(ci, n, t, fp_saves);
+    register_cpu_stat(ci, n, t, fp_save_bytes);
+    register_cpu_histogram(ci, n, t, runq_delay);
+    register_cpu_histogram(ci, n, t, wakeup_latency);
+    register_cpu_histogram(ci, n, t, slice_length);
+    return (tuple)n;
+}
+
+void init_scheduler_management(tuple root)
+{
+    heap h = heap_locked(get_kernel_heaps());
+    tuple sched = allocate_tuple();
+    assert(sched != INVALID_ADDRESS);
+    tuple cpus = allocate_tuple();
+    assert(cpus != INVALID_ADDRESS);
+    for (u64 i = 0; i < total_processors; i++)
+        set(cpus, intern_u64(i), sched_cpu_management(h, cpuinfo_from_id(i)));
+    set(sched, sym(cpus), cpus);
+
+    /* lower bounds of histogram buckets, in microseconds */
+    buffer buckets = allocate_buffer(h, 128);
+    assert(buckets != INVALID_ADDRESS);
+    for (int i = 0; i < SCHED_LATENCY_BUCKETS; i++) {
+        if (i > 0)
+            push_u8(buckets, ' ');
+        print_number(buckets, i > 0 ? U64_FROM_BIT(i - 1) : 0, 10, 0);
+    }
+    set(sched, sym(latency_buckets_us), buckets);
+    set(sched, sym(no_encode), null_value);
+    set(root, sym(sched), sched);
+    register_root_notify(sym(idle_poll), closure(h, idle_poll_notify));
 }
 
 static boolean sched_sort(void *a, void *b)
 {
     sched_task ta = a, tb = b;
+    u32 pa = sched_task_prio(ta), pb = sched_task_prio(tb);
+    if (pa != pb)
+        return pa < pb;
+    if (ta->sched_class == SCHED_CLASS_RT)
+        return ta->rt_order > tb->rt_order;
     return (ta->runtime > tb->runtime);
 }
 
@@ -301,35 +651,208 @@ boolean sched_queue_init(sched_queue sq, heap h)
     sq->q = allocate_pqueue(h, sched_sort);
     if (sq->q == INVALID_ADDRESS)
         return false;
+    sq->inbox = allocate_queue(h, SCHED_INBOX_SIZE);
+    if (sq->inbox == INVALID_ADDRESS) {
+        deallocate_pqueue(sq->q);
+        return false;
+    }
     sq->min_runtime = 0;
     spin_lock_init(&sq->lock);
     return true;
 }
 
-void sched_enqueue(sched_queue sq, sched_task task)
+/* call with sq->lock held */
+static void sched_insert_locked(sched_queue sq, sched_task task)
 {
-    spin_lock(&sq->lock);
     sched_debug("sq %p, enqueuing task %p, runtime %T\n", sq, task, task->runtime);
-    task->runtime += sq->min_runtime;
+    if (task->sched_class == SCHED_CLASS_FAIR)
+        task->runtime += sq->min_runtime;
     pqueue_insert(sq->q, task);
+}
+
+/* call with sq->lock held, for a task taken from the queue proper */
+static void sched_take_locked(sched_queue sq, sched_task task)
+{
+    sched_debug("sq %p, took task %p, runtime %T\n", sq, task,
+                task->runtime - sq->min_runtime);
+    if (task->sched_class == SCHED_CLASS_FAIR)
+        sq->min_runtime = task->runtime;
+    task->runtime = 0;
+}
+
+/* call with sq->lock held */
+static void sched_merge_inbox(sched_queue sq)
+{
+    sched_task task;
+    while ((task = dequeue(sq->inbox)) != INVALID_ADDRESS)
+        sched_insert_locked(sq, task);
+}
+
+/* Return a CPU that is allowed to run the task, preferring the current one. */
+static cpuinfo sched_task_cpu(sched_task task, cpuinfo ci)
+{
+    if (task->pinned_cpu >= 0)
+        return cpuinfo_from_id(task->pinned_cpu);
+    if (sched_task_allowed(task, ci->id))
+        return ci;
+    u64 cpu = bitmap_range_get_first(task->affinity, 0, total_processors);
+    return cpu != INVALID_PHYSICAL ? cpuinfo_from_id(cpu) : ci;
+}
+
+/* Placement of a task woken up on behalf of another CPU: stay on the CPU
+   the task last ran on, where its cache state is likely to be, if that CPU
+   is idle or lightly loaded. Otherwise look for an idle CPU, starting with
+   those numbered next to it. */
+static cpuinfo sched_wake_cpu(sched_task task, cpuinfo last)
+{
+    if (task->pinned_cpu >= 0 || bitmap_get(idle_cpu_mask, last->id) ||
+        sched_queue_length(&last->thread_queue) <= SCHED_WAKE_AFFINE_MAX_QUEUED)
+        return last;
+    u64 first = last->id + 1;
+    u64 ncpus = total_processors - first;
+    u64 cpu;
+    for (int pass = 0; pass < 2; pass++) {
+        while ((ncpus > 0) &&
+               ((cpu = bitmap_range_get_first(idle_cpu_mask, first, ncpus)) != INVALID_PHYSICAL)) {
+            if (sched_task_allowed(task, cpu))
+                return cpuinfo_from_id(cpu);
+            ncpus -= cpu - first + 1;
+            first = cpu + 1;
+        }
+        first = 0;
+        ncpus = last->id;
+    }
+    return last;
+}
+
+/* A real-time task keeps its place among tasks of equal priority when
+   preempted, unless it is round-robin and has used up its time slice. */
+static void sched_rt_order(sched_task task)
+{
+    if (task->rr) {
+        task->rr_used += task->runtime;
+        if (task->rr_used >= microseconds(SCHED_RR_TIMESLICE_US)) {
+            task->rr_used = 0;
+            task->rt_order = 0;
+        }
+    }
+    if (!task->rt_order)
+        task->rt_order = task->enqueued;
+}
+
+/* Interrupt a CPU that is running a task of lower precedence. */
+static void sched_preempt_cpu(cpuinfo target, sched_task task)
+{
+    if (target->state == cpu_user && sched_task_prio(task) > target->sched_prio) {
+        sched_debug("preempting CPU %d\n", target->id);
+        send_wakeup_ipi(target);
+    }
+}
+
+void sched_enqueue(sched_queue sq, sched_task task)
+{
+    cpuinfo ci = current_cpu();
+    if (!task->enqueued)
+        task->enqueued = now(CLOCK_ID_MONOTONIC_RAW);
+    if (task->sched_class == SCHED_CLASS_RT)
+        sched_rt_order(task);
+    cpuinfo target = sched_queue_cpu(sq);
+    if (!sched_task_allowed(task, target->id)) {
+        target = sched_task_cpu(task, ci);
+        sq = &target->thread_queue;
+    }
+
+    if (target != ci) {
+        target = sched_wake_cpu(task, target);
+        sq = &target->thread_queue;
+    }
+
+    /* Enqueues to another CPU's queue must not contend with its owner. */
+    if (target != ci) {
+        if (!enqueue(sq->inbox, task)) {
+            spin_lock(&sq->lock);
+            sched_insert_locked(sq, task);
+            spin_unlock(&sq->lock);
+        }
+        wakeup_cpu(target->id);
+        sched_preempt_cpu(target, task);
+        return;
+    }
+    spin_lock(&sq->lock);
+    sched_insert_locked(sq, task);
     spin_unlock(&sq->lock);
 }
 
 sched_task sched_dequeue(sched_queue sq)
 {
+    u64 cpu = sched_queue_cpu(sq)->id;
+    sched_task task;
+  retry:
     spin_lock(&sq->lock);
-    sched_task task = pqueue_pop(sq->q);
+    sched_merge_inbox(sq);
+    task = pqueue_pop(sq->q);
+    if (task != INVALID_ADDRESS)
+        sched_take_locked(sq, task);
+    spin_unlock(&sq->lock);
+    if (task != INVALID_ADDRESS && !sched_task_allowed(task, cpu)) {
+        /* affinity changed since the task was enqueued */
+        sched_enqueue(sq, task);
+        goto retry;
+    }
+    return task;
+}
+
+/* Take a task that may run on the given CPU from another queue. Tasks still in
+   the inbox have not yet been ordered against the owner's queue, so take
+   those first; only take from the queue proper if its lock is free. */
+sched_task sched_steal(sched_queue sq, u64 cpu)
+{
+    sched_task task = dequeue(sq->inbox);
     if (task != INVALID_ADDRESS) {
-        sched_debug("sq %p, dequeued task %p, runtime %T\n", sq, task,
-                    task->runtime - sq->min_runtime);
-        sq->min_runtime = task->runtime;
-        task->runtime = 0;
+        if (sched_task_allowed(task, cpu)) {
+            sched_debug("sq %p, stole task %p from inbox\n", sq, task);
+            /* Its runtime is relative, as it was never inserted; account
+               it as if it had been queued and taken on the thief's queue. */
+            sched_queue tq = &cpuinfo_from_id(cpu)->thread_queue;
+            spin_lock(&tq->lock);
+            if (task->sched_class == SCHED_CLASS_FAIR)
+                task->runtime += tq->min_runtime;
+            sched_take_locked(tq, task);
+            spin_unlock(&tq->lock);
+            return task;
+        }
+        /* not ours to take; leave it to the owner */
+        if (!enqueue(sq->inbox, task)) {
+            spin_lock(&sq->lock);
+            sched_insert_locked(sq, task);
+            spin_unlock(&sq->lock);
+        }
+    }
+    if (pqueue_length(sq->q) == 0 || !spin_try(&sq->lock))
+        return INVALID_ADDRESS;
+    task = pqueue_peek(sq->q);
+    if (task != INVALID_ADDRESS && sched_task_allowed(task, cpu)) {
+        pqueue_pop(sq->q);
+        sched_take_locked(sq, task);
+    } else {
+        task = INVALID_ADDRESS;
     }
     spin_unlock(&sq->lock);
     return task;
 }
 
+void sched_task_affinity_update(sched_task task)
+{
+    u64 cpu = bitmap_range_get_first(task->affinity, 0, total_processors);
+    if (cpu != INVALID_PHYSICAL && (cpu == total_processors - 1 ||
+        bitmap_range_get_first(task->affinity, cpu + 1,
+                               total_processors - cpu - 1) == INVALID_PHYSICAL))
+        task->pinned_cpu = cpu;
+    else
+        task->pinned_cpu = -1;
+}
+
 u64 sched_queue_length(sched_queue sq)
 {
-    return pqueue_length(sq->q);
+    return pqueue_length(sq->q) + queue_length(sq->inbox);
 }
@@ -9,8 +9,8 @@
 #include <symtab.h>
 #include <virtio/virtio.h>
 
-closure_function(2, 1, void, program_start,
-                 buffer, elf, process, kp,
+closure_function(3, 1, void, program_start,
+                 buffer, elf, fsfile, f, process, kp,
                  status, s)
 {
     if (!is_ok(s))
@@ -27,7 +27,7 @@ closure_function(2, 1, void, program_start,
                      &bss_ro_after_init_end - &bss_ro_after_init_start,
                      pageflags_memory());
 
-    exec_elf(bound(elf), bound(kp));
+    exec_elf(bound(elf), bound(f), bound(kp));
     closure_finish();
 }
 
@@ -149,6 +149,8 @@ closure_function(6, 0, void, startup,
     /* register root tuple with management and kick off interfaces, if any */
     init_management_root(root);
     init_kernel_heaps_management(root);
+    init_scheduler_management(root);
+    init_mm_management(root);
 #if 0
     http_listener hl = allocate_http_listener(general, 9090);
     assert(hl != INVALID_ADDRESS);
@@ -169,14 +171,24 @@ closure_function(6, 0, void, startup,
     if (get(root, sym(exec_protection)))
         set(pro, sym(exec), null_value);  /* set executable flag */
     init_network_iface(root);
-    filesystem_read_entire(fs, pro, (heap)heap_page_backed(kh), pg, closure(general, read_program_fail));
+
+    /* Symbol ingestion and ltrace work on an in-memory image of the program;
+       otherwise only its headers are read and it is demand-paged. */
+    fsfile f = fsfile_from_node(fs, pro);
+    if (f && !get(root, sym(ingest_program_symbols)) && !get(root, sym(ltrace))) {
+        closure_member(program_start, start, f) = f;
+        exec_read_headers(f, pg, closure(general, read_program_fail));
+    } else {
+        filesystem_read_entire(fs, pro, (heap)heap_page_backed(kh), pg,
+                               closure(general, read_program_fail));
+    }
     closure_finish();
 }
 
 thunk create_init(kernel_heaps kh, tuple root, filesystem fs, merge *m)
 {
     heap h = heap_locked(kh);
-    status_handler start = closure(h, program_start, 0, 0);
+    status_handler start = closure(h, program_start, 0, 0, 0);
     *m = allocate_merge(h, start);
     return closure(h, startup, kh, root, fs, *m, start, apply_merge(*m));
 }
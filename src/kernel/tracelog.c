@@ -93,7 +93,7 @@ static inline void schedule_collator(void)
 static inline void schedule_collator_timer(void)
 {
     tracelog_debug("%s\n", __func__);
-    register_timer(kernel_timers, &tracelog.collate_timer, CLOCK_ID_MONOTONIC,
+    register_timer(kernel_timerqueue(), &tracelog.collate_timer, CLOCK_ID_MONOTONIC,
                    seconds(TRACELOG_COLLATE_TIMER_PERIOD_SEC), false, 0,
                    (timer_handler)&tracelog.collate_timer_func);
 }
@@ -1639,7 +1639,7 @@ closure_function(6, 2, void, sendmmsg_complete,
     hdr->msg_len = rv;
     bound(index)++;
     if (bound(index) < bound(vlen)) {
-        enqueue(runqueue, &bound(next));
+        enqueue(current_cpu()->runqueue, &bound(next));
         return;
     }
   out:
@@ -1774,7 +1774,7 @@ closure_function(6, 2, void, recvmmsg_complete,
     if (bound(index) < bound(vlen)) {
         if (bound(flags) & MSG_WAITFORONE)
             bound(flags) = (bound(flags) & ~MSG_WAITFORONE) | MSG_DONTWAIT;
-        enqueue(runqueue, &bound(next));
+        enqueue(current_cpu()->runqueue, &bound(next));
         return;
     }
   out:
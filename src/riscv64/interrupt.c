@@ -266,6 +266,7 @@ void trap_interrupt(void)
     if (is_kernel_context(ctx) || is_syscall_context(ctx)) {
         context_release_refcount(ctx);
         if (saved_state != cpu_idle) {
+            bhqueue_handoff(ci);
             ci->state = cpu_kernel;
             frame_return(f);
         }
@@ -383,6 +384,12 @@ void send_ipi(u64 cpu, u8 vector)
     }
 }
 
+void send_ipi_mask(bitmap targets, u8 vector)
+{
+    bitmap_foreach_set(targets, i)
+        send_ipi_internal(i, vector);
+}
+
 void init_interrupts(kernel_heaps kh)
 {
     int_general = heap_locked(kh);
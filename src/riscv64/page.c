@@ -42,6 +42,11 @@ void flush_tlb(boolean full_flush)
         asm volatile("sfence.vma" ::: "memory");
 }
 
+void flush_tlb_user(void)
+{
+    flush_tlb(true);
+}
+
 void init_mmu(range init_pt, u64 vtarget, void *dtb)
 {
     /* XXX init_pt doesn't have to be a 2m page right? */
@@ -96,6 +96,11 @@ static inline pageflags pageflags_default_user(void)
     return pageflags_user(pageflags_minpage(pageflags_memory()));
 }
 
+static inline pageflags pageflags_for_address(pageflags flags, u64 vaddr)
+{
+    return flags;
+}
+
 static inline boolean pageflags_is_writable(pageflags flags)
 {
     return (flags.w & PAGE_WRITABLE) != 0;
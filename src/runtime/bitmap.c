@@ -7,6 +7,12 @@
 
    The bitmap length may be arbitrarily sized. The bitmap buffer is
    allocated in ALLOC_EXTEND_BITS / 8 byte increments as needed.
+
+   Bitmaps used for allocation may keep summaries of which words are
+   full and which are in use (see bitmap_enable_summary()). Searches
+   then skip over runs of full or in-use words a summary word at a time,
+   so the cost of an allocation doesn't grow with the occupancy of the
+   map.
 */
 
 #include <runtime.h>
@@ -15,6 +21,9 @@
 #define BITMAP_WORDLEN          (1 << BITMAP_WORDLEN_LOG)
 #define BITMAP_WORDMASK         (BITMAP_WORDLEN - 1)
 
+/* map bits covered by a word of summary */
+#define BITMAP_SUMMARY_BITS     (BITMAP_WORDLEN * BITMAP_WORDLEN)
+
 static inline u64 * pointer_from_bit(u64 * base, u64 bit)
 {
     return base + (bit >> BITMAP_WORDLEN_LOG);
@@ -74,6 +83,106 @@ static boolean for_range_in_map(u64 * base, u64 start, u64 nbits, boolean set, b
     return true;
 }
 
+static inline u64 summary_bytes(u64 mapbits)
+{
+    return pad(mapbits >> BITMAP_WORDLEN_LOG, BITMAP_WORDLEN) >> 3;
+}
+
+static inline u64 *summary_base(buffer s)
+{
+    return buffer_ref(s, 0);
+}
+
+boolean bitmap_extend_summary(bitmap b, u64 mapbits)
+{
+    u64 bytes = summary_bytes(mapbits);
+    return extend_total(b->full_map, bytes) && extend_total(b->used_map, bytes);
+}
+
+void bitmap_update_summary(bitmap b, u64 start_word, u64 end_word)
+{
+    u64 *mapbase = bitmap_base(b);
+    u64 *full = summary_base(b->full_map);
+    u64 *used = summary_base(b->used_map);
+    for (u64 w = start_word; w < end_word; w++) {
+        u64 mask = U64_FROM_BIT(w & BITMAP_WORDMASK);
+        u64 x = mapbase[w];
+        word_op(pointer_from_bit(full, w), mask, true, x == -1ull);
+        word_op(pointer_from_bit(used, w), mask, true, x != 0);
+    }
+}
+
+boolean bitmap_enable_summary(bitmap b)
+{
+    if (!b->map)
+        return false;
+    u64 bytes = summary_bytes(b->mapbits);
+    b->full_map = allocate_buffer(b->map, bytes);
+    if (b->full_map == INVALID_ADDRESS)
+        goto fail;
+    b->used_map = allocate_buffer(b->map, bytes);
+    if (b->used_map == INVALID_ADDRESS) {
+        deallocate_buffer(b->full_map);
+        goto fail;
+    }
+    zero(summary_base(b->full_map), bytes);
+    buffer_produce(b->full_map, bytes);
+    zero(summary_base(b->used_map), bytes);
+    buffer_produce(b->used_map, bytes);
+    bitmap_update_summary(b, 0, b->mapbits >> BITMAP_WORDLEN_LOG);
+    return true;
+  fail:
+    b->full_map = b->used_map = 0;
+    return false;
+}
+
+static void set_range_in_map(bitmap b, u64 start, u64 nbits, boolean val)
+{
+    for_range_in_map(bitmap_base(b), start, nbits, true, val);
+    if (b->full_map && nbits > 0)
+        bitmap_update_summary(b, start >> BITMAP_WORDLEN_LOG,
+                              ((start + nbits - 1) >> BITMAP_WORDLEN_LOG) + 1);
+}
+
+/* first word at or after word which isn't full */
+static u64 next_nonfull_word(bitmap b, u64 word)
+{
+    u64 nwords = b->mapbits >> BITMAP_WORDLEN_LOG;
+    if (word >= nwords)
+        return word;
+    u64 *full = summary_base(b->full_map);
+    u64 i = word >> BITMAP_WORDLEN_LOG;
+    u64 x = ~full[i] & ~MASK(word & BITMAP_WORDMASK);
+    while (!x) {
+        if (++i << BITMAP_WORDLEN_LOG >= nwords)
+            return nwords;
+        x = ~full[i];
+    }
+    return (i << BITMAP_WORDLEN_LOG) + lsb(x);
+}
+
+/* Returns false if any of the words fully covered by an allocation at
+   (word-aligned) bit are known to be in use, in which case *next is the next
+   candidate. */
+static boolean multiword_candidate(bitmap b, u64 bit, u64 nbits, u64 stride, u64 *next)
+{
+    u64 word = bit >> BITMAP_WORDLEN_LOG;
+    u64 nwords = b->mapbits >> BITMAP_WORDLEN_LOG;
+    if (nbits < BITMAP_WORDLEN || word >= nwords)
+        return true;
+    u64 *used = summary_base(b->used_map);
+    if (stride <= BITMAP_SUMMARY_BITS && *pointer_from_bit(used, word) == -1ull) {
+        *next = pad(bit + 1, BITMAP_SUMMARY_BITS);
+        return false;
+    }
+    u64 n = MIN(nbits >> BITMAP_WORDLEN_LOG, nwords - word);
+    if (!for_range_in_map(used, word, n, false, false)) {
+        *next = bit + stride;
+        return false;
+    }
+    return true;
+}
+
 /* Requesting beyond the end of maxbits isn't an error; the caller may
    use it to avoid an additional range check.
 
@@ -87,9 +196,10 @@ boolean bitmap_range_check_and_set(bitmap b, u64 start, u64 nbits, boolean valid
         return false;
 
     bitmap_extend(b, start + nbits - 1);
-    u64 * mapbase = bitmap_base(b);
-    return (!validate || for_range_in_map(mapbase, start, nbits, false, !set)) &&
-        for_range_in_map(mapbase, start, nbits, true, set);
+    if (validate && !for_range_in_map(bitmap_base(b), start, nbits, false, !set))
+        return false;
+    set_range_in_map(b, start, nbits, set);
+    return true;
 }
 
 /* Returns the first bit set in a given range, or INVALID_PHYSICAL if no bits are set. */
@@ -132,11 +242,14 @@ static inline u64 bitmap_alloc_internal(bitmap b, u64 nbits, u64 startbit, u64 e
     if (stride >= 64) {
         /* multi-word */
         while (bit <= endbit) {
+            if (b->used_map && !multiword_candidate(b, bit, nbits, stride, &bit))
+                continue;
+
             if (bitmap_extend(b, bit + nbits))
                 mapbase = bitmap_base(b);
 
             if (for_range_in_map(mapbase, bit, nbits, false, false)) {
-                for_range_in_map(mapbase, bit, nbits, true, true);
+                set_range_in_map(b, bit, nbits, true);
                 return bit;
             }
 
@@ -147,6 +260,15 @@ static inline u64 bitmap_alloc_internal(bitmap b, u64 nbits, u64 startbit, u64 e
             /* get offset (for start bit, 0 otherwise) and align bit to word boundary */
             int word_offset = bit & 63;
             bit -= word_offset;
+            if (b->full_map) {
+                u64 word = next_nonfull_word(b, bit >> BITMAP_WORDLEN_LOG);
+                if ((word << BITMAP_WORDLEN_LOG) != bit) {
+                    bit = word << BITMAP_WORDLEN_LOG;
+                    word_offset = 0;
+                    if (bit > endbit)
+                        return INVALID_PHYSICAL;
+                }
+            }
             if (bitmap_extend(b, bit + 64))
                 mapbase = bitmap_base(b);
 
@@ -161,7 +283,7 @@ static inline u64 bitmap_alloc_internal(bitmap b, u64 nbits, u64 startbit, u64 e
                     return INVALID_PHYSICAL;
 
                 if ((bw & mask) == 0) {
-                    assert(for_range_in_map(mapbase, bit + word_offset, nbits, true, true));
+                    set_range_in_map(b, bit + word_offset, nbits, true);
                     return bit + word_offset;
                 }
 
@@ -209,7 +331,7 @@ boolean bitmap_dealloc(bitmap b, u64 bit, u64 size)
 	return false;
     }
 
-    for_range_in_map(mapbase, bit, size, true, false);
+    set_range_in_map(b, bit, size, false);
     return true;
 }
 
@@ -224,6 +346,7 @@ static inline bitmap allocate_bitmap_internal(heap meta, u64 length)
 	length = -1ull << 6; /* don't pad to 0 */
     b->maxbits = length;
     b->mapbits = MIN(ALLOC_EXTEND_BITS, pad(b->maxbits, 64));
+    b->full_map = b->used_map = 0;
     return b;
 }
 
@@ -246,6 +369,10 @@ void deallocate_bitmap(bitmap b)
 {
     if (b->alloc_map)
 	deallocate_buffer(b->alloc_map);
+    if (b->full_map) {
+        deallocate_buffer(b->full_map);
+        deallocate_buffer(b->used_map);
+    }
     deallocate(b->meta, b, sizeof(struct bitmap));
 }
 
@@ -282,6 +409,10 @@ bitmap bitmap_clone(bitmap b)
     c->meta = b->meta;
     runtime_memcpy(buffer_ref(c->alloc_map, 0), buffer_ref(b->alloc_map, 0), mapbytes);
     buffer_produce(c->alloc_map, mapbytes);
+    if (b->full_map && !bitmap_enable_summary(c)) {
+        deallocate_bitmap(c);
+        return INVALID_ADDRESS;
+    }
     return c;
 }
 
@@ -299,4 +430,6 @@ void bitmap_copy(bitmap dest, bitmap src)
 	bytes len = (dest->mapbits - src->mapbits) >> 3;
 	zero(buffer_ref(dest->alloc_map, off), len);
     }
+    if (dest->full_map)
+        bitmap_update_summary(dest, 0, dest->mapbits >> BITMAP_WORDLEN_LOG);
 }
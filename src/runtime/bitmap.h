@@ -8,6 +8,12 @@ typedef struct bitmap {
     heap meta;
     heap map;
     buffer alloc_map;
+    /* Optional summaries with a bit per word of alloc_map, set if the word
+       is full or in use, respectively. They let allocations skip over whole
+       words at a time; bitmap_set_atomic() and direct writes to the map
+       don't maintain them. */
+    buffer full_map;
+    buffer used_map;
 } *bitmap;
 
 boolean bitmap_range_check_and_set(bitmap b, u64 start, u64 nbits, boolean validate, boolean set);
@@ -21,6 +27,9 @@ bitmap bitmap_wrap(heap h, u64 * map, u64 length);
 void bitmap_unwrap(bitmap b);
 bitmap bitmap_clone(bitmap b);
 void bitmap_copy(bitmap dest, bitmap src);
+boolean bitmap_enable_summary(bitmap b);
+void bitmap_update_summary(bitmap b, u64 start_word, u64 end_word);
+boolean bitmap_extend_summary(bitmap b, u64 mapbits);
 
 #define bitmap_foreach_word(b, w, offset)				\
     for (u64 offset = 0, * __wp = bitmap_base(b), w = *__wp;		\
@@ -43,7 +52,8 @@ static inline boolean bitmap_extend(bitmap b, u64 i)
 {
     if (i >= b->mapbits) {
         u64 mapbits = pad(i + 1, ALLOC_EXTEND_BITS);
-        if (extend_total(b->alloc_map, mapbits >> 3)) {
+        if (extend_total(b->alloc_map, mapbits >> 3) &&
+            (!b->full_map || bitmap_extend_summary(b, mapbits))) {
             b->mapbits = mapbits;
             return true;
         }
@@ -68,6 +78,8 @@ static inline void bitmap_set(bitmap b, u64 i, int val)
 	*p |= mask;
     else
 	*p &= ~mask;
+    if (b->full_map)
+        bitmap_update_summary(b, i >> 6, (i >> 6) + 1);
 }
 
 static inline void bitmap_set_atomic(bitmap b, u64 i, int val)
@@ -59,6 +59,9 @@ caching_heap allocate_objcache_preallocated(heap meta, heap parent, bytes objsiz
 boolean objcache_validate(heap h);
 heap objcache_from_object(u64 obj, bytes parent_pagesize);
 heap allocate_mcache(heap meta, heap parent, int min_order, int max_order, bytes pagesize);
+int mcache_size_class(heap h, bytes b);
+int mcache_object_class(heap h, u64 a);
+bytes mcache_class_size(heap h, int c);
 heap reserve_heap_wrapper(heap meta, heap parent, bytes reserved);
 
 // really internals
@@ -72,6 +72,11 @@ static id_range id_add_range(id_heap i, u64 base, u64 length)
         msg_err("%s: failed to allocate bitmap for range %R\n", __func__, ir->n.r);
         goto fail;
     }
+    if (!bitmap_enable_summary(ir->b)) {
+        msg_err("%s: failed to allocate bitmap summary for range %R\n", __func__, ir->n.r);
+        deallocate_bitmap(ir->b);
+        goto fail;
+    }
     zero(ir->next_bit, sizeof(ir->next_bit));
     i->total += length;
     id_debug("added range base 0x%lx, end 0x%lx (length 0x%lx)\n", base, base + length, length);
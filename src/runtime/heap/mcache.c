@@ -11,6 +11,9 @@
    child heaps and not the parent. malloc/calloc functions exposed to
    such code should assert that the requested size does not exceed the
    maximum size passed to allocate_mcache (1ull << max_order).
+
+   Caches are indexed by size class (order - min_order), so the cache
+   for a given size is found without a search.
 */
 
 //#define MCACHE_DEBUG
@@ -22,13 +25,37 @@ typedef struct mcache {
     struct heap h;
     heap parent;
     heap meta;
-    vector caches;
+    vector caches;          /* indexed by size class */
+    int min_order;
     u64 pagesize;
     u64 allocated;
     u64 parent_threshold;
     tuple mgmt;
 } *mcache;
 
+int mcache_size_class(heap h, bytes b)
+{
+    mcache m = (mcache)h;
+    if (b > m->parent_threshold)
+        return -1;
+    int order = find_order(b);
+    return order > m->min_order ? order - m->min_order : 0;
+}
+
+int mcache_object_class(heap h, u64 a)
+{
+    mcache m = (mcache)h;
+    heap o = objcache_from_object(a, m->pagesize);
+    if (o == INVALID_ADDRESS)
+        return -1;
+    return find_order(o->pagesize) - m->min_order;
+}
+
+bytes mcache_class_size(heap h, int c)
+{
+    return U64_FROM_BIT(((mcache)h)->min_order + c);
+}
+
 u64 mcache_alloc(heap h, bytes b)
 {
     mcache m = (mcache)h;
@@ -56,33 +83,31 @@ u64 mcache_alloc(heap h, bytes b)
         }
     }
 
-    /* Could become a binary search if search set is large... */
-    vector_foreach(m->caches, o) {
-	if (o && b <= o->pagesize) {
+    int c = mcache_size_class(h, b);
+    if (c >= 0 && (o = vector_get(m->caches, c))) {
 #ifdef MCACHE_DEBUG
-	    rputs("match cache ");
-	    print_u64(u64_from_pointer(o));
-	    rputs(" obj size ");
-	    print_u64(o->pagesize);
-	    rputs(", pre validate...");
-	    if (objcache_validate((heap)o))
-		rputs("pass, alloc ");
-	    else
-		halt("failed!\n");
+	rputs("match cache ");
+	print_u64(u64_from_pointer(o));
+	rputs(" obj size ");
+	print_u64(o->pagesize);
+	rputs(", pre validate...");
+	if (objcache_validate((heap)o))
+	    rputs("pass, alloc ");
+	else
+	    halt("failed!\n");
 #endif
-	    u64 a = allocate_u64(o, o->pagesize);
-	    if (a != INVALID_PHYSICAL)
-		m->allocated += o->pagesize;
+	u64 a = allocate_u64(o, o->pagesize);
+	if (a != INVALID_PHYSICAL)
+	    m->allocated += o->pagesize;
 #ifdef MCACHE_DEBUG
-	    print_u64(a);
-	    rputs(", post validate...");
-	    if (objcache_validate((heap)o))
-		rputs("pass\n");
-	    else
-		halt("failed!\n");
+	print_u64(a);
+	rputs(", post validate...");
+	if (objcache_validate((heap)o))
+	    rputs("pass\n");
+	else
+	    halt("failed!\n");
 #endif
-	    return a;
-	}
+	return a;
     }
 #ifdef MCACHE_DEBUG
     rputs("no matching cache; fail\n");
@@ -286,7 +311,8 @@ heap allocate_mcache(heap meta, heap parent, int min_order, int max_order, bytes
     m->h.management = mcache_management;
     m->meta = meta;
     m->parent = parent;
-    m->caches = allocate_vector(meta, 1);
+    m->caches = allocate_vector(meta, max_order - min_order + 1);
+    m->min_order = min_order;
     m->pagesize = pagesize;
     m->allocated = 0;
     m->parent_threshold = U64_FROM_BIT(max_order);
@@ -4,9 +4,14 @@
    per-page free list. This can later expand into being a true
    slab-like object cache with object constructors, etc.
 
+   In the kernel, locking caches keep a per-cpu magazine of objects in
+   front of the shared, locked cache. Magazines are refilled and
+   flushed in batches, so most allocations and deallocations take no
+   lock.
+
    issues / todo:
 
-   - Per-page locks may reduce contention.
+   - Per-page locks may reduce contention on magazine misses.
 
    - See notes in allocate_objcache() with regard to supporting
      multi-page parent head allocations.
@@ -22,6 +27,9 @@
 #endif
 #include <management.h>
 
+/* check frees against all per-cpu magazines, not just the current one */
+//#define OBJCACHE_DEBUG
+
 #define FOOTER_MAGIC    (u16)(0xcafe)
 
 typedef struct objcache *objcache;
@@ -34,6 +42,20 @@ typedef struct footer {
     struct list list;       /* full list if avail == 0, free otherwise */
 } *footer;
 
+#ifdef KERNEL
+declare_closure_struct(1, 0, void, objcache_magazine_drain,
+                       objcache, o);
+
+typedef struct objcache_magazine {
+    u64 count;              /* objects in magazine */
+    u64 hits;               /* alloc / dealloc without touching shared cache */
+    u64 misses;
+    u64 objs[OBJCACHE_MAGAZINE_SIZE];
+    u32 drain_queued;       /* drain pending on the owning cpu */
+    closure_struct(objcache_magazine_drain, drain);
+} *objcache_magazine;
+#endif
+
 typedef struct objcache {
     struct caching_heap ch;
     heap meta;
@@ -49,6 +71,8 @@ typedef struct objcache {
     tuple mgmt;
 #ifdef KERNEL
     struct spinlock lock;
+    objcache_magazine mags; /* per-cpu, allocated once cpus are counted */
+    u64 nmags;
 #endif
 } *objcache;
 
@@ -253,13 +277,31 @@ static void objcache_destroy(heap h)
         deallocate_u64(o->parent, page_from_footer(o, f), page_size(o));
     foreach_page_footer(&o->full, f)
         deallocate_u64(o->parent, page_from_footer(o, f), page_size(o));
+#ifdef KERNEL
+    if (o->mags)
+        deallocate(o->meta, o->mags, o->nmags * sizeof(struct objcache_magazine));
+#endif
     deallocate(o->meta, o, sizeof(struct objcache));
 }
 
+#ifdef KERNEL
+/* Objects held in magazines are accounted as free. The sum is taken
+   without locking and may be slightly stale. */
+static u64 objcache_magazine_objs(objcache o)
+{
+    u64 objs = 0;
+    for (u64 i = 0; i < o->nmags; i++)
+        objs += o->mags[i].count;
+    return objs;
+}
+#else
+#define objcache_magazine_objs(o) 0
+#endif
+
 static u64 objcache_allocated(heap h)
 {
     objcache o = (objcache)h;
-    return o->alloced_objs * object_size(o);
+    return (o->alloced_objs - objcache_magazine_objs(o)) * object_size(o);
 }
 
 static u64 objcache_total(heap h)
@@ -424,6 +466,36 @@ closure_function(2, 0, value, objcache_get_free,
     return value_rewrite_u64(bound(v), objcache_total(h) - objcache_allocated(h));
 }
 
+#ifdef KERNEL
+static u64 objcache_alloc_locking(heap h, bytes size);
+
+closure_function(2, 0, value, objcache_get_magazine_objs,
+                 objcache, o, value, v)
+{
+    return value_rewrite_u64(bound(v), objcache_magazine_objs(bound(o)));
+}
+
+closure_function(2, 0, value, objcache_get_magazine_hits,
+                 objcache, o, value, v)
+{
+    objcache o = bound(o);
+    u64 hits = 0;
+    for (u64 i = 0; i < o->nmags; i++)
+        hits += o->mags[i].hits;
+    return value_rewrite_u64(bound(v), hits);
+}
+
+closure_function(2, 0, value, objcache_get_magazine_misses,
+                 objcache, o, value, v)
+{
+    objcache o = bound(o);
+    u64 misses = 0;
+    for (u64 i = 0; i < o->nmags; i++)
+        misses += o->mags[i].misses;
+    return value_rewrite_u64(bound(v), misses);
+}
+#endif
+
 #define register_stat(o, n, t, name)                                    \
     v = value_from_u64(o->meta, 0);                                     \
     s = sym(name);                                                      \
@@ -444,6 +516,13 @@ static value objcache_management(heap h)
     register_stat(o, n, t, allocated);
     register_stat(o, n, t, total);
     register_stat(o, n, t, free);
+#ifdef KERNEL
+    if (o->ch.h.alloc == objcache_alloc_locking) {
+        register_stat(o, n, t, magazine_objs);
+        register_stat(o, n, t, magazine_hits);
+        register_stat(o, n, t, magazine_misses);
+    }
+#endif
     o->mgmt = (tuple)n;
     return n;
 }
@@ -485,26 +564,171 @@ static inline bytes objcache_drain(struct caching_heap *ch, bytes size, bytes re
 
 #define objcache_lock(h) (&((objcache)(h))->lock)
 
+static objcache_magazine objcache_cpu_magazine(objcache o);
+static void objcache_magazine_flush(objcache o, objcache_magazine m, u64 count);
+
+/* Run from the cpu_queue of the cpu owning the magazine. */
+define_closure_function(1, 0, void, objcache_magazine_drain,
+                        objcache, o)
+{
+    objcache o = bound(o);
+    u64 flags = irq_disable_save();
+    objcache_magazine m = objcache_cpu_magazine(o);
+    if (m) {
+        spin_lock(objcache_lock(o));
+        objcache_magazine_flush(o, m, 0);
+        spin_unlock(objcache_lock(o));
+        m->drain_queued = 0;
+    }
+    irq_restore(flags);
+}
+
+/* Called with interrupts disabled. Magazines are set up on first use after
+   the number of cpus is known; until then, the shared cache is used. */
+static objcache_magazine objcache_cpu_magazine(objcache o)
+{
+    objcache_magazine mags = o->mags;
+    if (!mags) {
+        u64 n = present_processors;
+        if (n == 0)
+            return 0;
+        mags = allocate_zero(o->meta, n * sizeof(struct objcache_magazine));
+        if (mags == INVALID_ADDRESS)
+            return 0;
+        for (u64 i = 0; i < n; i++)
+            init_closure(&mags[i].drain, objcache_magazine_drain, o);
+        spin_lock(objcache_lock(o));
+        if (o->mags) {
+            spin_unlock(objcache_lock(o));
+            deallocate(o->meta, mags, n * sizeof(struct objcache_magazine));
+            mags = o->mags;
+        } else {
+            o->mags = mags;
+            o->nmags = n;
+            spin_unlock(objcache_lock(o));
+        }
+    }
+    u64 id = current_cpu()->id;
+    return id < o->nmags ? &mags[id] : 0;
+}
+
+/* called with cache lock held */
+static void objcache_magazine_flush(objcache o, objcache_magazine m, u64 count)
+{
+    while (m->count > count)
+        objcache_deallocate((heap)o, m->objs[--m->count], object_size(o));
+}
+
 static u64 objcache_alloc_locking(heap h, bytes size)
 {
-    u64 flags = spin_lock_irq(objcache_lock(h));
-    u64 a = objcache_allocate(h, size);
-    spin_unlock_irq(objcache_lock(h), flags);
+    objcache o = (objcache)h;
+    u64 flags = irq_disable_save();
+    objcache_magazine m = objcache_cpu_magazine(o);
+    u64 a;
+    if (!m || size != object_size(o)) {
+        spin_lock(objcache_lock(h));
+        a = objcache_allocate(h, size);
+        spin_unlock(objcache_lock(h));
+    } else {
+        if (m->count == 0) {
+            m->misses++;
+            spin_lock(objcache_lock(h));
+            while (m->count < OBJCACHE_MAGAZINE_SIZE / 2) {
+                a = objcache_allocate(h, size);
+                if (a == INVALID_PHYSICAL)
+                    break;
+                m->objs[m->count++] = a;
+            }
+            spin_unlock(objcache_lock(h));
+        } else {
+            m->hits++;
+        }
+        a = m->count ? m->objs[--m->count] : INVALID_PHYSICAL;
+    }
+    irq_restore(flags);
     return a;
 }
 
+/* Called with interrupts disabled. A magazine object is still accounted as
+   allocated in its page, so an object freed twice would otherwise be handed
+   out twice. Only the current magazine is searched unless OBJCACHE_DEBUG is
+   defined; the page and cache counts are read without locking. */
+static boolean objcache_magazine_free_valid(objcache o, objcache_magazine m, footer f, u64 x)
+{
+    if (f->avail >= o->objs_per_page || o->alloced_objs == 0)
+        return false;
+#ifdef OBJCACHE_DEBUG
+    for (m = o->mags; m < o->mags + o->nmags; m++)
+#endif
+    for (u64 i = 0; i < m->count; i++) {
+        if (m->objs[i] == x)
+            return false;
+    }
+    return true;
+}
+
 static void objcache_dealloc_locking(heap h, u64 x, bytes size)
 {
-    u64 flags = spin_lock_irq(objcache_lock(h));
-    objcache_deallocate(h, x, size);
-    spin_unlock_irq(objcache_lock(h), flags);
+    objcache o = (objcache)h;
+    u64 flags = irq_disable_save();
+    objcache_magazine m = objcache_cpu_magazine(o);
+    footer f = footer_from_page(o, page_from_obj(o, x));
+    if (!m || size != object_size(o) || !validate_page(o, f)) {
+        /* let the shared cache report any error */
+        spin_lock(objcache_lock(h));
+        objcache_deallocate(h, x, size);
+        spin_unlock(objcache_lock(h));
+    } else if (!objcache_magazine_free_valid(o, m, f, x)) {
+        msg_err("objcache %p: object 0x%lx is not allocated (double free?); leaking\n", o, x);
+    } else {
+        if (m->count == OBJCACHE_MAGAZINE_SIZE) {
+            m->misses++;
+            spin_lock(objcache_lock(h));
+            objcache_magazine_flush(o, m, OBJCACHE_MAGAZINE_SIZE / 2);
+            spin_unlock(objcache_lock(h));
+        } else {
+            m->hits++;
+        }
+        m->objs[m->count++] = x;
+    }
+    irq_restore(flags);
+}
+
+/* Magazines can only be accessed by their owning cpu, so other cpus are
+   asked to flush theirs via their cpu_queue. Their objects are returned to
+   the shared cache asynchronously and become drainable on a later drain. */
+static void objcache_drain_remote_magazines(objcache o)
+{
+    objcache_magazine mags = o->mags;
+    if (!mags)
+        return;
+    u64 self = current_cpu()->id;
+    boolean queued = false;
+    for (u64 i = 0; i < o->nmags; i++) {
+        objcache_magazine m = &mags[i];
+        if (i == self || m->count == 0 || !compare_and_swap_32(&m->drain_queued, 0, 1))
+            continue;
+        if (enqueue_irqsafe(cpuinfo_from_id(i)->cpu_queue, &m->drain))
+            queued = true;
+        else
+            m->drain_queued = 0;
+    }
+    if (queued)
+        wakeup_or_interrupt_cpu_all();
 }
 
 static bytes objcache_drain_locking(struct caching_heap *ch, bytes size, bytes retain)
 {
-    u64 flags = spin_lock_irq(objcache_lock(ch));
+    objcache o = (objcache)ch;
+    u64 flags = irq_disable_save();
+    objcache_magazine m = objcache_cpu_magazine(o);
+    spin_lock(objcache_lock(ch));
+    if (m)
+        objcache_magazine_flush(o, m, 0);
     u64 drained = objcache_drain(ch, size, retain);
-    spin_unlock_irq(objcache_lock(ch), flags);
+    spin_unlock(objcache_lock(ch));
+    objcache_drain_remote_magazines(o);
+    irq_restore(flags);
     return drained;
 }
 
@@ -581,6 +805,10 @@ caching_heap allocate_objcache(heap meta, heap parent, bytes objsize, bytes page
     o->wrapper_heap = 0;
     o->mgmt = 0;
     o->prealloc_only = false;
+#ifdef KERNEL
+    o->mags = 0;
+    o->nmags = 0;
+#endif
 
     return (caching_heap)o;
 }
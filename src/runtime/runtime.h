@@ -70,6 +70,10 @@ void runtime_memset(u8 *a, u8 b, bytes len);
 
 int runtime_memcmp(const void *a, const void *b, bytes len);
 
+#ifdef __x86_64__
+extern boolean memops_erms;
+#endif
+
 static inline int runtime_strlen(const char *a)
 {
     int i = 0;
@@ -30,6 +30,216 @@ static boolean timer_compare_simple(void *za, void *zb)
     return ((timer)za)->expiry > ((timer)zb)->expiry;
 }
 
+/* Timer wheel: each level has TIMER_WHEEL_SLOTS slots, with a slot in level n
+   spanning TIMER_WHEEL_SLOTS^n ticks. A timer is placed in the lowest level
+   that covers its distance from the wheel clock, and timers in upper levels
+   are cascaded downwards as the clock reaches their slot. */
+#define TIMER_WHEEL_LEVEL_ORDER 6
+#define TIMER_WHEEL_SLOTS       U64_FROM_BIT(TIMER_WHEEL_LEVEL_ORDER)
+#define TIMER_WHEEL_LEVELS      6
+
+typedef struct timer_wheel {
+    u64 clk;                    /* next tick to be serviced */
+    int tick_order;
+    u64 count;
+    u64 occupied[TIMER_WHEEL_LEVELS];
+    struct list slots[TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS];
+} *timer_wheel;
+
+#define timer_wheel_shift(level) ((level) * TIMER_WHEEL_LEVEL_ORDER)
+
+static void timer_wheel_insert(timerqueue tq, timer t)
+{
+    timer_wheel w = tq->wheel;
+    timestamp expiry = timerqueue_expiry(tq, t);
+    u64 tick = (expiry >> w->tick_order) + ((expiry & MASK(w->tick_order)) ? 1 : 0);
+    if (tick < w->clk)
+        tick = w->clk;
+    u64 delta = tick - w->clk;
+    int level = delta ? msb(delta) / TIMER_WHEEL_LEVEL_ORDER : 0;
+    if (level >= TIMER_WHEEL_LEVELS) {
+        /* beyond the wheel span: park in the last slot, to be re-placed when
+           it is cascaded */
+        level = TIMER_WHEEL_LEVELS - 1;
+        tick = w->clk + MASK(timer_wheel_shift(TIMER_WHEEL_LEVELS));
+    }
+    u64 index = (tick >> timer_wheel_shift(level)) & (TIMER_WHEEL_SLOTS - 1);
+    t->slot = level * TIMER_WHEEL_SLOTS + index;
+    list_insert_before(&w->slots[t->slot], &t->l);
+    w->occupied[level] |= U64_FROM_BIT(index);
+    w->count++;
+}
+
+static void timer_wheel_remove(timer_wheel w, timer t)
+{
+    list_delete(&t->l);
+    if (list_empty(&w->slots[t->slot]))
+        w->occupied[t->slot / TIMER_WHEEL_SLOTS] &= ~U64_FROM_BIT(t->slot & (TIMER_WHEEL_SLOTS - 1));
+    w->count--;
+}
+
+/* Move the contents of a slot to list l. Timers in l remain accounted for
+   in the wheel, so that they can be removed with timer_wheel_remove(). */
+static void timer_wheel_detach(timer_wheel w, int level, u64 index, struct list *l)
+{
+    struct list *slot = &w->slots[level * TIMER_WHEEL_SLOTS + index];
+    if (list_empty(slot)) {
+        list_init(l);
+        return;
+    }
+    list_replace(slot, l);
+    list_init(slot);
+    w->occupied[level] &= ~U64_FROM_BIT(index);
+}
+
+/* Returns the first tick, starting from the wheel clock, at which either a
+   level 0 slot expires or an upper level slot is cascaded. */
+static u64 timer_wheel_next_tick(timer_wheel w)
+{
+    u64 next = infinity;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++) {
+        u64 occupied = w->occupied[level];
+        if (!occupied)
+            continue;
+        int shift = timer_wheel_shift(level);
+        u64 index = (w->clk >> shift) & (TIMER_WHEEL_SLOTS - 1);
+        u64 base = (w->clk >> (shift + TIMER_WHEEL_LEVEL_ORDER)) << (shift + TIMER_WHEEL_LEVEL_ORDER);
+
+        /* the current slot is due only if the clock is at its start */
+        if (w->clk & MASK(shift))
+            index++;
+        u64 m = index < TIMER_WHEEL_SLOTS ? occupied & (-1ull << index) : 0;
+        u64 tick = m ? base + (lsb(m) << shift) :
+            base + U64_FROM_BIT(shift + TIMER_WHEEL_LEVEL_ORDER) + (lsb(occupied) << shift);
+        next = MIN(next, tick);
+    }
+    return next;
+}
+
+static void timer_wheel_cascade(timerqueue tq)
+{
+    timer_wheel w = tq->wheel;
+    for (int level = TIMER_WHEEL_LEVELS - 1; level > 0; level--) {
+        int shift = timer_wheel_shift(level);
+        if (w->clk & MASK(shift))
+            continue;
+        u64 index = (w->clk >> shift) & (TIMER_WHEEL_SLOTS - 1);
+        if (!(w->occupied[level] & U64_FROM_BIT(index)))
+            continue;
+        struct list l;
+        timer_wheel_detach(w, level, index, &l);
+        list_foreach(&l, e) {
+            timer t = struct_from_list(e, timer, l);
+            timer_wheel_remove(w, t);
+            timer_wheel_insert(tq, t);
+        }
+    }
+}
+
+static void timer_wheel_refresh_locked(timerqueue tq)
+{
+    timer_wheel w = tq->wheel;
+    if (!w->count) {
+        tq->empty = true;
+        return;
+    }
+    tq->next_expiry = timer_wheel_next_tick(w) << w->tick_order;
+    tq->empty = false;
+    tq->update = true;
+}
+
+static void timer_wheel_service(timerqueue tq, timestamp here)
+{
+    timer_wheel w = tq->wheel;
+    u64 target = here >> w->tick_order;
+    u64 overruns;
+
+    timer_lock(tq);
+    while (w->count) {
+        u64 tick = timer_wheel_next_tick(w);
+        if (tick > target)
+            break;
+        w->clk = tick;
+        timer_wheel_cascade(tq);
+        struct list expired;
+        timer_wheel_detach(w, 0, tick & (TIMER_WHEEL_SLOTS - 1), &expired);
+        w->clk = tick + 1;
+
+        /* The lock is dropped while invoking handlers, during which timers
+           may be removed from the expired list. */
+        while (!list_empty(&expired)) {
+            timer t = struct_from_list(expired.next, timer, l);
+            timer_wheel_remove(w, t);
+            s64 delta = here - timerqueue_expiry(tq, t);
+            if (delta < 0) {
+                /* expiry was adjusted after the timer was placed */
+                timer_wheel_insert(tq, t);
+                continue;
+            }
+            assert(t->active && t->queued);
+            boolean interval = t->interval != 0;
+            if (interval) {
+                /* account for all elapsed periods, as the timer cannot be
+                   serviced again within this tick */
+                overruns = delta / t->interval + 1;
+                t->expiry += t->interval * overruns;
+            } else {
+                overruns = 1;
+                t->active = false;
+            }
+            t->queued = false;
+            timer_unlock(tq);
+            timer_debug("timer %p: expiry %T, overruns %ld, delta %T, apply handler %p (%F)\n",
+                        t, timerqueue_expiry(tq, t), overruns, delta, t->handler, t->handler);
+            apply(t->handler, t->expiry, overruns);
+            timer_lock(tq);
+            if (interval) {
+                if (t->active) {
+                    t->queued = true;
+                    timer_wheel_insert(tq, t);
+                } else {
+                    timer_unlock(tq);
+                    apply(t->handler, 0, timer_disabled);
+                    timer_lock(tq);
+                }
+            }
+        }
+    }
+    if (w->clk <= target)
+        w->clk = target + 1;
+    timer_wheel_refresh_locked(tq);
+    timer_unlock(tq);
+}
+
+static boolean timer_wheel_walk(timer_wheel w, pqueue_element_handler h)
+{
+    for (int i = 0; i < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; i++) {
+        list_foreach(&w->slots[i], e) {
+            if (!apply(h, struct_from_list(e, timer, l)))
+                return false;
+        }
+    }
+    return true;
+}
+
+/* Re-place all timers after a change in their expiry values. */
+static void timer_wheel_reorder(timerqueue tq)
+{
+    timer_wheel w = tq->wheel;
+    struct list l;
+    list_init(&l);
+    for (int i = 0; i < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; i++) {
+        list_foreach(&w->slots[i], e) {
+            timer_wheel_remove(w, struct_from_list(e, timer, l));
+            list_insert_before(&l, e);
+        }
+    }
+    list_foreach(&l, e) {
+        list_delete(e);
+        timer_wheel_insert(tq, struct_from_list(e, timer, l));
+    }
+}
+
 void register_timer(timerqueue tq, timer t, clock_id id,
                     timestamp val, boolean absolute, timestamp interval, timer_handler n)
 {
@@ -42,16 +252,32 @@ void register_timer(timerqueue tq, timer t, clock_id id,
     t->queued = true;
     t->handler = n;
 
+    t->tq = tq;
     timer_lock(tq);
-    pqueue_insert(tq->pq, t);
-    timer next = pqueue_peek(tq->pq);
-    refresh_timer_update_locked(tq, next);
+    if (tq->wheel) {
+        /* An empty wheel may have fallen behind; catch it up so that the
+           timer is placed in the lowest possible level. */
+        timer_wheel w = tq->wheel;
+        if (!w->count) {
+            u64 tick = timerqueue_now(tq, t) >> w->tick_order;
+            if (tick > w->clk)
+                w->clk = tick;
+        }
+        timer_wheel_insert(tq, t);
+        timer_wheel_refresh_locked(tq);
+    } else {
+        pqueue_insert(tq->pq, t);
+        timer next = pqueue_peek(tq->pq);
+        refresh_timer_update_locked(tq, next);
+    }
     timer_unlock(tq);
     timer_debug("register timer: %p, expiry %T, interval %T, handler %p\n", t, t->expiry, interval, n);
 }
 
 boolean remove_timer(timerqueue tq, timer t, timestamp *remain)
 {
+    if (t->tq)
+        tq = t->tq;
     timer_lock(tq);
     timestamp x = t->expiry;
 
@@ -66,7 +292,10 @@ boolean remove_timer(timerqueue tq, timer t, timestamp *remain)
         /* We are able to remove the timer from the queue, so we can safely
            invoke the timer handler here. */
         t->queued = false;
-        assert(pqueue_remove(tq->pq, t));
+        if (tq->wheel)
+            timer_wheel_remove(tq->wheel, t);
+        else
+            assert(pqueue_remove(tq->pq, t));
         timer_unlock(tq);
         apply(t->handler, 0, timer_disabled);
     } else {
@@ -93,6 +322,10 @@ void timer_service(timerqueue tq, timestamp here)
     u64 overruns;
 
     timer_debug("timer_service enter for heap \"%s\" at %T\n", tq->name, here);
+    if (tq->wheel) {
+        timer_wheel_service(tq, here);
+        return;
+    }
     timer_lock(tq);
     while (((t = pqueue_peek(tq->pq)) != INVALID_ADDRESS) &&
            (delta = here - timerqueue_expiry(tq, t), delta >= 0)) {
@@ -134,7 +367,12 @@ void timer_service(timerqueue tq, timestamp here)
 void timer_reorder(timerqueue tq)
 {
     timer_lock(tq);
-    pqueue_reorder(tq->pq);
+    if (tq->wheel) {
+        timer_wheel_reorder(tq);
+        timer_wheel_refresh_locked(tq);
+    } else {
+        pqueue_reorder(tq->pq);
+    }
     timer_unlock(tq);
 }
 
@@ -145,19 +383,19 @@ void timer_adjust_begin(timerqueue tq)
 
 void timer_adjust_end(timerqueue tq, pqueue_element_handler h)
 {
-    pqueue_walk(tq->pq, h);
-    pqueue_reorder(tq->pq);
+    if (tq->wheel) {
+        timer_wheel_walk(tq->wheel, h);
+        timer_wheel_reorder(tq);
+        timer_wheel_refresh_locked(tq);
+    } else {
+        pqueue_walk(tq->pq, h);
+        pqueue_reorder(tq->pq);
+    }
     timer_unlock(tq);
 }
 
-timerqueue allocate_timerqueue(heap h, clock_now now, const char *name)
+static void init_timerqueue(timerqueue tq, heap h, clock_now now, const char *name)
 {
-    timerqueue tq = allocate(h, sizeof(struct timerqueue));
-    tq->pq = allocate_pqueue(h, now ? timer_compare_simple : timer_compare);
-    if (tq->pq == INVALID_ADDRESS) {
-        deallocate(h, tq, sizeof(struct timerqueue));
-        return INVALID_ADDRESS;
-    }
     tq->h = h;
     tq->now = now;
     tq->name = name;
@@ -169,12 +407,52 @@ timerqueue allocate_timerqueue(heap h, clock_now now, const char *name)
     tq->service = 0;
     tq->min = tq->max = 0;
 #endif
+}
+
+timerqueue allocate_timerqueue(heap h, clock_now now, const char *name)
+{
+    timerqueue tq = allocate(h, sizeof(struct timerqueue));
+    if (tq == INVALID_ADDRESS)
+        return tq;
+    tq->pq = allocate_pqueue(h, now ? timer_compare_simple : timer_compare);
+    if (tq->pq == INVALID_ADDRESS) {
+        deallocate(h, tq, sizeof(struct timerqueue));
+        return INVALID_ADDRESS;
+    }
+    tq->wheel = 0;
+    init_timerqueue(tq, h, now, name);
+    return tq;
+}
+
+timerqueue allocate_timer_wheel(heap h, clock_now now, int tick_order, const char *name)
+{
+    timerqueue tq = allocate(h, sizeof(struct timerqueue));
+    if (tq == INVALID_ADDRESS)
+        return tq;
+    timer_wheel w = allocate(h, sizeof(struct timer_wheel));
+    if (w == INVALID_ADDRESS) {
+        deallocate(h, tq, sizeof(struct timerqueue));
+        return INVALID_ADDRESS;
+    }
+    w->tick_order = tick_order;
+    w->count = 0;
+    for (int level = 0; level < TIMER_WHEEL_LEVELS; level++)
+        w->occupied[level] = 0;
+    for (int i = 0; i < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS; i++)
+        list_init(&w->slots[i]);
+    w->clk = 0;
+    tq->pq = 0;
+    tq->wheel = w;
+    init_timerqueue(tq, h, now, name);
     return tq;
 }
 
 void deallocate_timerqueue(timerqueue tq)
 {
-    deallocate_pqueue(tq->pq);
+    if (tq->wheel)
+        deallocate(tq->h, tq->wheel, sizeof(struct timer_wheel));
+    else
+        deallocate_pqueue(tq->pq);
     deallocate(tq->h, tq, sizeof(struct timerqueue));
 }
 
@@ -32,6 +32,7 @@ typedef struct timerqueue {
 #endif
     heap h;
     pqueue pq;
+    struct timer_wheel *wheel;  /* if non-null, used in place of pq */
     timestamp next_expiry;      /* adjusted */
     thunk service;
 
@@ -58,12 +59,16 @@ struct timer {
     boolean active;
     boolean queued;
     timer_handler handler;
+    timerqueue tq;              /* queue the timer was last registered on */
+    struct list l;              /* timer wheel slot linkage */
+    u16 slot;
 };
 
 static inline void init_timer(timer t)
 {
     t->active = false;
     t->queued = false;
+    t->tq = 0;
 }
 
 static inline boolean timer_is_active(timer t)
@@ -158,12 +163,20 @@ static inline void refresh_timer_update_locked(timerqueue tq, timer next)
    execution.
 
    If remain is nonzero and removal was successful, *remain is set to the time
-   remaining until timer elapse. */
+   remaining until timer elapse.
+
+   The timer is removed from the queue it was registered on, which may differ
+   from tq if the latter is another CPU's timer queue. */
 boolean remove_timer(timerqueue tq, timer t, timestamp *remain);
 
 typedef closure_type(timer_select, boolean, timer);
 
 timerqueue allocate_timerqueue(heap h, clock_now now, const char *name);
+
+/* A hierarchical timing wheel gives constant-time timer registration and
+   removal, at the cost of servicing expiries with a granularity of
+   2^tick_order timestamp units; timers never fire early. */
+timerqueue allocate_timer_wheel(heap h, clock_now now, int tick_order, const char *name);
 void deallocate_timerqueue(timerqueue tq);
 void timer_service(timerqueue tq, timestamp here);
 void timer_reorder(timerqueue tq);
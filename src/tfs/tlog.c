@@ -526,7 +526,7 @@ void log_flush(log tl, status_handler completion)
     if (tl->flushing || tl->compacting)
         return;
 #ifdef KERNEL
-    remove_timer(kernel_timers, &tl->flush_timer, 0);
+    remove_timer(kernel_timerqueue(), &tl->flush_timer, 0);
 #endif
     tl->flushing = true;
     merge m = allocate_merge(tl->h, closure(tl->h, log_flush_complete, tl));
@@ -600,7 +600,7 @@ static void log_set_dirty(log tl)
         return;
     }
     tl->dirty = true;
-    register_timer(kernel_timers, &tl->flush_timer, CLOCK_ID_MONOTONIC_RAW,
+    register_timer(kernel_timerqueue(), &tl->flush_timer, CLOCK_ID_MONOTONIC_RAW,
                    seconds(TFS_LOG_FLUSH_DELAY_SECONDS), false, 0,
                    closure(tl->h, log_flush_timer_expired, tl));
 }
@@ -917,7 +917,7 @@ log log_create(heap h, filesystem fs, boolean initialize, status_handler sh)
 void log_destroy(log tl)
 {
 #ifdef KERNEL
-    remove_timer(kernel_timers, &tl->flush_timer, 0);
+    remove_timer(kernel_timerqueue(), &tl->flush_timer, 0);
 #endif
     deallocate_vector(tl->flush_completions);
 #ifndef TLOG_READ_ONLY
@@ -86,7 +86,7 @@ static inline boolean blockq_wake_internal_locked(blockq bq, thread t, u64 bq_fl
 {
     boolean timer_pending = t->bq_timer_pending;
     if (timer_pending) {
-        if (remove_timer(kernel_timers, &t->bq_timer, &t->bq_remain_at_wake)) {
+        if (remove_timer(kernel_timerqueue(), &t->bq_timer, &t->bq_remain_at_wake)) {
             t->bq_timer_pending = false;
         } else {
             /* The timeout already fired, so let it proceed and skip the wakeup. */
@@ -165,7 +165,7 @@ void blockq_resume_blocking(blockq bq, thread t)
         timestamp tr = t->bq_remain_at_wake;
         t->bq_remain_at_wake = 0;
         t->bq_timer_pending = true;
-        register_timer(kernel_timers, &t->bq_timer, t->bq_clkid, tr,
+        register_timer(kernel_timerqueue(), &t->bq_timer, t->bq_clkid, tr,
                        false, 0, (timer_handler)&t->bq_timeout_func);
     }
     blockq_unlock(bq);
@@ -222,7 +222,7 @@ sysreturn blockq_check_timeout(blockq bq, thread t, blockq_action a, boolean in_
     if (timeout > 0) {
         t->bq_timer_pending = true;
         t->bq_clkid = clkid;
-        register_timer(kernel_timers, &t->bq_timer, clkid, timeout, absolute, 0,
+        register_timer(kernel_timerqueue(), &t->bq_timer, clkid, timeout, absolute, 0,
                        init_closure(&t->bq_timeout_func, blockq_thread_timeout, bq, t));
     } else {
         t->bq_timer_pending = false;
@@ -283,7 +283,7 @@ int blockq_transfer_waiters(blockq dest, blockq src, int n, blockq_action_handle
         clock_id id = 0;
         if (timer_pending) {
             id = t->bq_timer.id;
-            if (!remove_timer(kernel_timers, &t->bq_timer, &remain)) {
+            if (!remove_timer(kernel_timerqueue(), &t->bq_timer, &remain)) {
                 /* This waiter timed out, but the timeout has yet to be
                    serviced. Instead of moving this waiter to the new queue,
                    leave it to finish timing out. */
@@ -296,7 +296,7 @@ int blockq_transfer_waiters(blockq dest, blockq src, int n, blockq_action_handle
         list_insert_before(&dest->waiters_head, &t->bq_l);
         t->blocked_on = dest;
         if (timer_pending && remain > 0) {
-            register_timer(kernel_timers, &t->bq_timer, id, remain, false, 0,
+            register_timer(kernel_timerqueue(), &t->bq_timer, id, remain, false, 0,
                            init_closure(&t->bq_timeout_func, blockq_thread_timeout,
                                         dest, t));
         } else {
@@ -142,7 +142,6 @@ static boolean add_thread_status(buffer b, thread t, struct siginfo *si)
 
 #ifdef __x86_64__
 #define XCR0_OFFSET 464     /* points into sw_reserved of fxregs_state */
-    extern u8 use_xsave;
     if (use_xsave) {
         u8 *xs = add_note(b, "LINUX", NT_X86_XSTATE, extended_frame_size);
         runtime_memcpy(xs, pointer_from_u64(thread_frame(t)[FRAME_EXTENDED]),
@@ -174,11 +174,24 @@ closure_function(0, 1, void, load_interp_fail,
     halt("read interp failed %v\n", s);
 }
 
-closure_function(3, 4, u64, exec_elf_map,
-                 process, p, kernel_heaps, kh, u32, allowed_flags,
+/* Demand-zero, like an anonymous mapping. The first page is populated when
+   the tail of the segment's file data is to be copied into it. */
+static void exec_map_bss(process p, u64 vaddr, u64 size, u64 vmflags, u32 allowed_flags,
+                         boolean populate)
+{
+    vmflags |= VMAP_FLAG_MMAP | VMAP_MMAP_TYPE_ANONYMOUS;
+    assert(allocate_vmap(p, irangel(vaddr, size), ivmap(vmflags, allowed_flags, 0, 0, 0)) !=
+           INVALID_ADDRESS);
+    if (populate)
+        assert(new_zeroed_pages(vaddr, PAGESIZE, pageflags_from_vmflags(vmflags), 0) !=
+               INVALID_PHYSICAL);
+}
+
+/* maps segments of a program image loaded in memory */
+closure_function(2, 4, u64, exec_elf_map,
+                 process, p, u32, allowed_flags,
                  u64, vaddr, u64, paddr, u64, size, pageflags, flags)
 {
-    kernel_heaps kh = bound(kh);
     u64 vmflags = VMAP_FLAG_READABLE;
     if (pageflags_is_exec(flags))
         vmflags |= VMAP_FLAG_EXEC;
@@ -189,32 +202,162 @@ closure_function(3, 4, u64, exec_elf_map,
     boolean is_bss = paddr == INVALID_PHYSICAL;
     exec_debug("%s: add to vmap: %R vmflags 0x%lx%s\n",
                __func__, r, vmflags, is_bss ? " bss" : "");
-    assert(allocate_vmap(bound(p), r, ivmap(vmflags, bound(allowed_flags), 0, 0, 0)) !=
-           INVALID_ADDRESS);
     if (is_bss) {
-        /* bss */
-        paddr = allocate_u64((heap)heap_physical(kh), size);
-        assert(paddr != INVALID_PHYSICAL);
+        /* the loader may copy the tail of the file data into the first page */
+        exec_map_bss(bound(p), vaddr, size, vmflags, bound(allowed_flags), true);
+        return vaddr;
     }
+    assert(allocate_vmap(bound(p), r, ivmap(vmflags, bound(allowed_flags), 0, 0, 0)) !=
+           INVALID_ADDRESS);
     map(vaddr, paddr, size, pageflags_user(pageflags_minpage(flags)));
-    if (is_bss)
-        zero(pointer_from_u64(vaddr), size);
     return vaddr;
 }
 
-closure_function(2, 1, status, load_interp_complete,
-                 thread, t, kernel_heaps, kh,
+closure_function(1, 2, void, exec_read_tail_complete,
+                 status_handler, sh,
+                 status, s, bytes, count)
+{
+    apply(bound(sh), s);
+    closure_finish();
+}
+
+/* Map the loadable segments of an ELF file as private file-backed mappings of
+   its page cache node, so that they are demand-paged, share pages with the
+   page cache and are copied on write. File data sharing a page with the start
+   of a bss is read into that page, completing through the merge. */
+static void *exec_map_elf(process p, fsfile f, Elf64_Ehdr *e, u64 load_offset, u32 allowed_flags,
+                          merge m)
+{
+    heap h = heap_locked((kernel_heaps)p->uh);
+    pagecache_node pn = fsfile_get_cachenode(f);
+
+    /* the mappings hold no file descriptor, so pin the file for the life of the process */
+    fsfile_reserve(f);
+    foreach_phdr(e, ph) {
+        if (ph->p_type != PT_LOAD)
+            continue;
+        if (ph->p_memsz < ph->p_filesz)
+            halt("%s: p_memsz (%ld) < p_filesz (%ld)\n", __func__, ph->p_memsz, ph->p_filesz);
+        u64 vmflags = VMAP_FLAG_READABLE;
+        if (ph->p_flags & PF_X)
+            vmflags |= VMAP_FLAG_EXEC;
+        if (ph->p_flags & PF_W)
+            vmflags |= VMAP_FLAG_WRITABLE;
+        u64 vaddr = (ph->p_vaddr & ~PAGEMASK) + load_offset;
+        u64 offset = ph->p_offset & ~PAGEMASK;
+        u64 ssize = ph->p_filesz + (ph->p_vaddr & PAGEMASK);
+        u64 bss_size = ph->p_memsz - ph->p_filesz;
+        u64 tail_copy = bss_size > 0 ? ssize & PAGEMASK : 0;
+        ssize -= tail_copy;
+        exec_debug("%s: segment at 0x%lx, offset 0x%lx, ssize 0x%lx, bss_size 0x%lx, tail 0x%lx\n",
+                   __func__, vaddr, offset, ssize, bss_size, tail_copy);
+        if (ssize > 0)
+            assert(allocate_vmap(p, irangel(vaddr, pad(ssize, PAGESIZE)),
+                                 ivmap(vmflags | VMAP_FLAG_MMAP | VMAP_MMAP_TYPE_FILEBACKED,
+                                       allowed_flags, offset, pn, 0)) != INVALID_ADDRESS);
+        if (bss_size > 0) {
+            u64 bss_vaddr = vaddr + ssize;
+            exec_map_bss(p, bss_vaddr, pad(tail_copy + bss_size, PAGESIZE), vmflags,
+                         allowed_flags, tail_copy > 0);
+            if (tail_copy > 0) {
+                io_status_handler ish = closure(h, exec_read_tail_complete, apply_merge(m));
+                assert(ish != INVALID_ADDRESS);
+                filesystem_read_linear(f, pointer_from_u64(bss_vaddr),
+                                       irangel(offset + ssize, tail_copy), ish);
+            }
+        }
+    }
+    return pointer_from_u64(e->e_entry + load_offset);
+}
+
+closure_function(4, 2, void, exec_read_headers_complete,
+                 fsfile, f, buffer, b, buffer_handler, bh, status_handler, sh,
+                 status, s, bytes, count)
+{
+    buffer b = bound(b);
+    if (!is_ok(s))
+        goto fail;
+    buffer_produce(b, count);
+    Elf64_Ehdr *e = buffer_ref(b, 0);
+    if (count < sizeof(*e)) {
+        s = timm("result", "file too short for elf header");
+        goto fail;
+    }
+
+    /* program headers and the interpreter path may lie past the initial read */
+    u64 needed = e->e_phoff + e->e_phnum * e->e_phentsize;
+    if (needed <= count) {
+        foreach_phdr(e, ph) {
+            if (ph->p_type == PT_INTERP)
+                needed = MAX(needed, ph->p_offset + ph->p_filesz);
+        }
+    }
+    if (needed > count) {
+        if (needed > fsfile_get_length(bound(f))) {
+            s = timm("result", "elf headers extend past end of file");
+            goto fail;
+        }
+        buffer_clear(b);
+        if (!buffer_extend(b, needed)) {
+            s = timm("result", "failed to extend buffer");
+            goto fail;
+        }
+        filesystem_read_linear(bound(f), buffer_ref(b, 0), irange(0, needed),
+                               (io_status_handler)closure_self());
+        return;
+    }
+    apply(bound(bh), b);
+    closure_finish();
+    return;
+  fail:
+    deallocate_buffer(b);
+    apply(bound(sh), s);
+    closure_finish();
+}
+
+/* Reads the headers needed to map an ELF file from the page cache. */
+void exec_read_headers(fsfile f, buffer_handler bh, status_handler sh)
+{
+    heap h = heap_locked(get_kernel_heaps());
+    u64 len = MIN(fsfile_get_length(f), PAGESIZE);
+    buffer b = allocate_buffer(h, PAGESIZE);
+    if (b == INVALID_ADDRESS)
+        goto alloc_fail;
+    io_status_handler ish = closure(h, exec_read_headers_complete, f, b, bh, sh);
+    if (ish == INVALID_ADDRESS) {
+        deallocate_buffer(b);
+        goto alloc_fail;
+    }
+    filesystem_read_linear(f, buffer_ref(b, 0), irange(0, len), ish);
+    return;
+  alloc_fail:
+    apply(sh, timm("result", "allocation failure"));
+}
+
+closure_function(2, 1, void, exec_start,
+                 thread, t, void *, entry,
+                 status, s)
+{
+    if (!is_ok(s))
+        halt("failed to load program: %v\n", s);
+    exec_debug("starting process tid %d, start %p\n", bound(t)->tid, bound(entry));
+    start_process(bound(t), bound(entry));
+    closure_finish();
+}
+
+closure_function(5, 1, status, load_interp_complete,
+                 thread, t, fsfile, f, merge, m, status_handler, start, status_handler, sh,
                  buffer, b)
 {
     thread t = bound(t);
-    kernel_heaps kh = bound(kh);
 
-    exec_debug("interpreter load complete, reading elf\n");
+    exec_debug("interpreter headers read, mapping elf\n");
     u64 where = process_get_virt_range(t->p, HUGE_PAGESIZE, PROCESS_VIRTUAL_MMAP_RANGE);
     assert(where != INVALID_PHYSICAL);
-    void * start = load_elf(b, where, stack_closure(exec_elf_map, t->p, kh, 0));
-    exec_debug("starting process tid %d, start %p\n", t->tid, start);
-    start_process(t, start);
+    closure_member(exec_start, bound(start), entry) =
+        exec_map_elf(t->p, bound(f), buffer_ref(b, 0), where, 0, bound(m));
+    deallocate_buffer(b);
+    apply(bound(sh), STATUS_OK);
     closure_finish();
     return STATUS_OK;
 }
@@ -227,7 +370,9 @@ closure_function(1, 1, boolean, trace_notify,
     return true;
 }
 
-process exec_elf(buffer ex, process kp)
+/* If f is set, ex holds only the ELF headers and the program is mapped from
+   the page cache; otherwise ex holds the entire program image. */
+process exec_elf(buffer ex, fsfile f, process kp)
 {
     // is process md always root?
     unix_heaps uh = kp->uh;
@@ -285,7 +430,14 @@ process exec_elf(buffer ex, process kp)
                load_offset, load_range, range_span(load_range));
     u32 allowed_flags = proc_is_exec_protected(proc) ? 0 :
             (VMAP_FLAG_READABLE | VMAP_FLAG_WRITABLE | VMAP_FLAG_EXEC);
-    void * entry = load_elf(ex, load_offset, stack_closure(exec_elf_map, proc, kh, allowed_flags));
+    heap h = heap_locked(kh);
+    status_handler start = closure(h, exec_start, t, 0);
+    assert(start != INVALID_ADDRESS);
+    merge m = allocate_merge(h, start);
+    assert(m != INVALID_ADDRESS);
+    status_handler sh = apply_merge(m);
+    void *entry = f ? exec_map_elf(proc, f, e, load_offset, allowed_flags, m) :
+        load_elf(ex, load_offset, stack_closure(exec_elf_map, proc, allowed_flags));
 
     u64 brk_offset = aslr ? get_aslr_offset(PROCESS_HEAP_ASLR_RANGE) : 0;
     u64 brk = pad(load_range.end, PAGESIZE) + brk_offset;
@@ -313,13 +465,15 @@ process exec_elf(buffer ex, process kp)
         ltrace_init(ltrace, ex, load_offset);
     }
 
-    register_root_notify(sym(trace), closure(heap_locked(kh), trace_notify, proc));
+    register_root_notify(sym(trace), closure(h, trace_notify, proc));
 
     if (interp) {
         exec_debug("reading interp...\n");
-        filesystem_read_entire(fs, interp, (heap)heap_page_backed(kh),
-                               closure(heap_locked(kh), load_interp_complete, t, kh),
-                               closure(heap_locked(kh), load_interp_fail));
+        fsfile interp_f = fsfile_from_node(fs, interp);
+        if (!interp_f)
+            halt("program interpreter is not a file\n");
+        exec_read_headers(interp_f, closure(h, load_interp_complete, t, interp_f, m, start, sh),
+                          closure(h, load_interp_fail));
         return proc;
     }
 
@@ -331,8 +485,8 @@ process exec_elf(buffer ex, process kp)
             halt("unable to change cwd to \"%b\"; %s\n", cwd, string_from_fs_status(fss));
     }
 
-    exec_debug("starting process...\n");
-    start_process(t, entry);
-    return proc;    
+    closure_member(exec_start, start, entry) = entry;
+    apply(sh, STATUS_OK);
+    return proc;
 }
 
@@ -1723,7 +1723,7 @@ closure_function(4, 2, void, __ftrace_send_http_chunk,
     if (overruns != timer_disabled &&
         __ftrace_send_http_chunk_internal(bound(routine), bound(p),
                                           bound(local_printer), bound(out))) {
-        register_timer(kernel_timers, &bound(p)->t, CLOCK_ID_MONOTONIC, SEND_HTTP_CHUNK_INTERVAL_MS,
+        register_timer(kernel_timerqueue(), &bound(p)->t, CLOCK_ID_MONOTONIC, SEND_HTTP_CHUNK_INTERVAL_MS,
                        false, 0, (timer_handler)closure_self());
     } else {
         closure_finish();
@@ -1790,7 +1790,7 @@ __ftrace_do_http_method(buffer_handler out, struct ftrace_routine * routine,
         {
             timer_handler t = closure(ftrace_heap, __ftrace_send_http_chunk, routine,
                 p, local_printer, out);
-            register_timer(kernel_timers, &p->t, CLOCK_ID_MONOTONIC, SEND_HTTP_CHUNK_INTERVAL_MS, false, 0, t);
+            register_timer(kernel_timerqueue(), &p->t, CLOCK_ID_MONOTONIC, SEND_HTTP_CHUNK_INTERVAL_MS, false, 0, t);
         }
     }
 
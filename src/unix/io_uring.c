@@ -244,7 +244,7 @@ static void iour_release(io_uring iour)
 
 static void iour_timer_remove(io_uring iour, iour_timer t)
 {
-    if (remove_timer(kernel_timers, &t->t, 0)) {
+    if (remove_timer(kernel_timerqueue(), &t->t, 0)) {
         deallocate(iour->h, t, sizeof(*t));
         fetch_and_add(&iour->noncancelable_ops, -1);
     }
@@ -768,7 +768,7 @@ static void iour_timeout_add(io_uring iour, struct timespec *ts, u32 flags,
     fetch_and_add(&iour->noncancelable_ops, 1);
 
     list_push_back(&iour->timers, &iour_tim->l);
-    register_timer(kernel_timers, &iour_tim->t, CLOCK_ID_MONOTONIC,
+    register_timer(kernel_timerqueue(), &iour_tim->t, CLOCK_ID_MONOTONIC,
         time_from_timespec(ts), flags & IORING_TIMEOUT_ABS, 0,
         init_closure(&iour_tim->handler, iour_timeout, iour, iour_tim));
     iour_unlock(iour);
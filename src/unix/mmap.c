@@ -40,10 +40,17 @@ declare_closure_function(0, 2, int, pending_fault_compare,
                          rbnode, a, rbnode, b);
 declare_closure_function(0, 1, boolean, pending_fault_print,
                          rbnode, n);
+/* transparent huge pages */
+#define THP_NEVER   0
+#define THP_MADVISE 1           /* only where requested */
+#define THP_ALWAYS  2
+
 static struct {
     heap h;
     id_heap physical;
     heap linear_backed;
+    int thp_mode;
+    u64 fault_around;           /* bytes, power of 2 */
 
     closure_struct(pending_fault_compare, pf_compare);
     closure_struct(pending_fault_print, pf_print);
@@ -155,9 +162,47 @@ u64 new_zeroed_pages(u64 v, u64 length, pageflags flags, status_handler complete
     return mapped_p;
 }
 
-static boolean demand_anonymous_page(pending_fault pf, vmap vm, u64 vaddr)
+/* An anonymous fault is served with a huge page if the surrounding huge page
+   range lies within the vmap and has nothing mapped yet. Such faults are
+   tracked at the huge page address, so that concurrent faults within the
+   range wait for the first one. */
+static boolean anonymous_hugepage_eligible(vmap vm, u64 vaddr)
+{
+    if ((vm->flags & VMAP_FLAG_NOHUGEPAGE) ||
+        (mmap_info.thp_mode != THP_ALWAYS && !(vm->flags & VMAP_FLAG_HUGEPAGE)))
+        return false;
+    u64 start = vaddr & ~MASK(PAGELOG_2M);
+    return start >= vm->node.r.start && start + PAGESIZE_2M <= vm->node.r.end &&
+        map_range_is_empty(start, PAGESIZE_2M);
+}
+
+/* Fails without logging if physical memory is too fragmented for a huge page,
+   or if part of the range has been mapped since the eligibility check, in
+   which case the caller falls back to a small page. */
+static boolean new_zeroed_hugepage(u64 v, pageflags flags, status_handler complete)
 {
-    if (new_zeroed_pages(vaddr & ~MASK(PAGELOG), PAGESIZE, pageflags_from_vmflags(vm->flags),
+    void *m = allocate(mmap_info.linear_backed, PAGESIZE_2M);
+    if (m == INVALID_ADDRESS)
+        return false;
+    zero(m, PAGESIZE_2M);
+    write_barrier();
+    u64 p = phys_from_linear_backed_virt(u64_from_pointer(m));
+    if (!map_block_if_empty(v, p, PAGESIZE_2M, pageflags_no_minpage(flags), complete)) {
+        deallocate(mmap_info.linear_backed, m, PAGESIZE_2M);
+        return false;
+    }
+    return true;
+}
+
+static boolean demand_anonymous_page(pending_fault pf, vmap vm, u64 vaddr, boolean huge)
+{
+    pageflags flags = pageflags_from_vmflags(vm->flags);
+    u64 page_addr = vaddr & ~MASK(PAGELOG);
+    if (huge && new_zeroed_hugepage(pf->addr, flags, (status_handler)&pf->complete)) {
+        count_minor_fault();
+        return true;
+    }
+    if (new_zeroed_pages(page_addr, PAGESIZE, flags,
                          (status_handler)&pf->complete) == INVALID_PHYSICAL)
         return false;
     count_minor_fault();
@@ -174,15 +219,78 @@ define_closure_function(5, 0, void, thread_demand_file_page,
              __func__, pf, bound(node_offset), pf->addr);
     pagecache_map_page(pn, bound(node_offset), pf->addr, bound(flags),
                        (status_handler)&pf->complete);
+    if (vm->flags & VMAP_FLAG_RANDOM)
+        return;
+    u64 ra_size = (vm->flags & VMAP_FLAG_SEQUENTIAL) ? 2 * FILE_READAHEAD_DEFAULT :
+        FILE_READAHEAD_DEFAULT;
     range ra = irange(bound(node_offset) + PAGESIZE,
         vm->node_offset + range_span(vm->node.r));
     if (range_valid(ra)) {
-        if (range_span(ra) > FILE_READAHEAD_DEFAULT)
-            ra.end = ra.start + FILE_READAHEAD_DEFAULT;
+        if (range_span(ra) > ra_size)
+            ra.end = ra.start + ra_size;
         pagecache_node_fetch_pages(pn, ra);
     }
 }
 
+closure_function(2, 0, void, fault_around_fetch,
+                 pagecache_node, pn, range, r)
+{
+    pagecache_node_fetch_pages(bound(pn), bound(r));
+    closure_finish();
+}
+
+/* Map the resident pages within the aligned window around a file-backed fault
+   (or, for sequential access, a larger window past it) and start fetching the
+   rest. Each page is claimed with a pending fault so that a concurrent fault on
+   it waits instead of racing with the mapping. */
+static void filebacked_fault_around(process p, vmap vm, u64 page_addr, pageflags flags,
+                                    u64 padlen)
+{
+    u64 window = mmap_info.fault_around;
+    if (window <= PAGESIZE || (vm->flags & VMAP_FLAG_RANDOM))
+        return;
+    pagecache_node pn = vm->cache_node;
+    u64 base;
+    if (vm->flags & VMAP_FLAG_SEQUENTIAL) {
+        base = page_addr;
+        window *= 2;
+    } else {
+        base = page_addr & ~(window - 1);
+    }
+    u64 start = MAX(base, vm->node.r.start);
+    u64 end = MIN(base + window, vm->node.r.end);
+    end = MIN(end, vm->node.r.start + (padlen - vm->node_offset));
+    range missing = irange(0, 0);
+    for (u64 v = start; v < end; v += PAGESIZE) {
+        if (v == page_addr)
+            continue;
+        u64 irqflags = spin_lock_irq(&p->faulting_lock);
+        if (find_pending_fault_locked(p, v)) {
+            spin_unlock_irq(&p->faulting_lock, irqflags);
+            continue;
+        }
+        pending_fault pf = new_pending_fault_locked(p, v);
+        spin_unlock_irq(&p->faulting_lock, irqflags);
+        status_handler complete = (status_handler)&pf->complete;
+        u64 node_offset = vm->node_offset + (v - vm->node.r.start);
+        boolean mapped = !map_range_is_empty(v, PAGESIZE);
+        if (!mapped && pagecache_map_page_if_filled(pn, node_offset, v, flags, complete))
+            continue;
+        if (!mapped) {
+            if (range_empty(missing))
+                missing.start = node_offset;
+            missing.end = node_offset + PAGESIZE;
+        }
+        apply(complete, STATUS_OK);
+    }
+    pf_debug("   fault around %R, missing %R\n", irange(start, end), missing);
+    if (!range_empty(missing)) {
+        thunk t = closure(mmap_info.h, fault_around_fetch, pn, missing);
+        if (t != INVALID_ADDRESS)
+            async_apply_bh(t);
+    }
+}
+
 static void demand_page_suspend_context(thread t, pending_fault pf, context ctx)
 {
     pf_debug("%s: tid %d, pf %p, ctx %p (%d), switch to %p\n", __func__,
@@ -224,6 +332,7 @@ static boolean demand_filebacked_page(thread t, context ctx, vmap vm, u64 vaddr,
                                      (status_handler)&pf->complete)) {
         pf_debug("   immediate completion\n");
         count_minor_fault();
+        filebacked_fault_around(t->p, vm, page_addr, flags, padlen);
         if (is_thread_context(ctx))
             goto sched_thread_return;
         return true;
@@ -263,6 +372,11 @@ boolean do_demand_page(thread t, context ctx, u64 vaddr, vmap vm)
              vaddr, vm->flags);
     pf_debug("   vmap %p, context %p\n", vm, ctx);
 
+    int mmap_type = vm->flags & VMAP_MMAP_TYPE_MASK;
+    boolean huge = mmap_type == VMAP_MMAP_TYPE_ANONYMOUS && anonymous_hugepage_eligible(vm, vaddr);
+    if (huge)
+        page_addr = vaddr & ~MASK(PAGELOG_2M);
+
     process p = t->p;
     u64 flags = spin_lock_irq(&p->faulting_lock);
     pending_fault pf = find_pending_fault_locked(p, page_addr);
@@ -276,10 +390,9 @@ boolean do_demand_page(thread t, context ctx, u64 vaddr, vmap vm)
         pf = new_pending_fault_locked(p, page_addr);
         spin_unlock_irq(&p->faulting_lock, flags);
         pf_debug("   new pending_fault %p\n", pf);
-        int mmap_type = vm->flags & VMAP_MMAP_TYPE_MASK;
         switch (mmap_type) {
         case VMAP_MMAP_TYPE_ANONYMOUS:
-            return demand_anonymous_page(pf, vm, vaddr);
+            return demand_anonymous_page(pf, vm, vaddr, huge);
         case VMAP_MMAP_TYPE_FILEBACKED:
             if (demand_filebacked_page(t, ctx, vm, vaddr, pf))
                 return true;
@@ -493,35 +606,43 @@ static inline boolean validate_mmap_range(process p, range q)
     return range_valid(q) && q.start >= p->mmap_min_addr && q.end <= USER_LIMIT;
 }
 
-closure_function(3, 1, boolean, proc_virt_gap_handler,
-                 u64, size, boolean, randomize, u64 *, addr,
+closure_function(4, 1, boolean, proc_virt_gap_handler,
+                 u64, size, int, align_order, boolean, randomize, u64 *, addr,
                  range, r)
 {
     u64 size = bound(size);
-    if (range_span(r) <= size)
+    int order = bound(align_order);
+    u64 start = pad(r.start, U64_FROM_BIT(order));
+    if (start >= r.end || r.end - start <= size)
         return true;
 
     u64 offset;
     if (bound(randomize))
-        offset = (random_u64() % ((range_span(r) - size) >> PAGELOG)) << PAGELOG;
+        offset = (random_u64() % ((r.end - start - size) >> order)) << order;
     else
         offset = 0;
-    *bound(addr) = r.start + offset;
+    *bound(addr) = start + offset;
     return false;           /* finished, not failure */
 }
 
 /* Does NOT mark the returned address as allocated in the virtual heap. */
-static u64 process_get_virt_range_locked(process p, u64 size, range region)
+static u64 process_get_virt_range_aligned_locked(process p, u64 size, int align_order,
+                                                 range region)
 {
     assert(!(size & PAGEMASK));
     vmap_heap vmh = (vmap_heap)p->virtual;
     u64 addr = INVALID_PHYSICAL;
     rangemap_range_find_gaps(p->vmaps, region,
-                             stack_closure(proc_virt_gap_handler, size,
+                             stack_closure(proc_virt_gap_handler, size, align_order,
                                            vmh->randomize, &addr));
     return addr;
 }
 
+static u64 process_get_virt_range_locked(process p, u64 size, range region)
+{
+    return process_get_virt_range_aligned_locked(p, size, PAGELOG, region);
+}
+
 u64 process_get_virt_range(process p, u64 size, range region)
 {
     vmap_lock(p);
@@ -778,10 +899,12 @@ closure_function(1, 1, boolean, vmap_update_protections_validate,
    i:          |------------|
 */
 
-void vmap_update_protections_intersection(heap h, rangemap pvmap, range q, u32 newflags,
-                                          vmap match)
+/* replace the flags within mask for the part of match intersecting q */
+static void vmap_update_flags_intersection(rangemap pvmap, range q, u32 mask, u32 newflags,
+                                           vmap match)
 {
     vmap_debug("%s: vm %p %R prev flags 0x%x\n", __func__, match, match->node.r, match->flags);
+    newflags = (match->flags & ~mask) | newflags;
     if (newflags == match->flags)
         return;
 
@@ -792,9 +915,6 @@ void vmap_update_protections_intersection(heap h, rangemap pvmap, range q, u32 n
     boolean head = ri.start > rn.start;
     boolean tail = ri.end < rn.end;
 
-    /* protection flags only */
-    newflags = (match->flags & ~(VMAP_FLAG_WRITABLE | VMAP_FLAG_EXEC)) | newflags;
-
     if (!head && !tail) {
         /* updating flags may result in adjacent maps with same attributes;
            removing and reinserting the node will take care of merging */
@@ -839,6 +959,14 @@ void vmap_update_protections_intersection(heap h, rangemap pvmap, range q, u32 n
     }
 }
 
+void vmap_update_protections_intersection(heap h, rangemap pvmap, range q, u32 newflags,
+                                          vmap match)
+{
+    /* protection flags only */
+    vmap_update_flags_intersection(pvmap, q, VMAP_FLAG_WRITABLE | VMAP_FLAG_EXEC, newflags,
+                                   match);
+}
+
 closure_function(0, 1, boolean, vmap_update_protections_gap,
                  range, r)
 {
@@ -1124,8 +1252,18 @@ static sysreturn mmap(void *addr, u64 length, int prot, int flags, int fd, u64 o
         thread_log(current, "   MAP_GROWSDOWN is unsupported");
         return -EINVAL;
     }
-    if (flags & MAP_HUGETLB)
-        thread_log(current, "   MAP_HUGETLB not implemented; ignoring");
+    if (flags & MAP_HUGETLB) {
+        int size_order = (flags >> HUGETLB_FLAG_ENCODE_SHIFT) & HUGETLB_FLAG_ENCODE_MASK;
+        if (size_order && size_order != PAGELOG_2M) {
+            thread_log(current, "   MAP_HUGETLB with unsupported page size order %d", size_order);
+            return -EINVAL;
+        }
+        if (flags & MAP_ANONYMOUS) {
+            vmflags |= VMAP_FLAG_HUGEPAGE;
+        } else {
+            thread_log(current, "   MAP_HUGETLB for file mapping not supported; ignoring");
+        }
+    }
     if (flags & MAP_SYNC)
         thread_log(current, "   MAP_SYNC not implemented; ignoring");
 
@@ -1228,7 +1366,11 @@ static sysreturn mmap(void *addr, u64 length, int prot, int flags, int fd, u64 o
             (flags & MAP_32BIT) ? PROCESS_VIRTUAL_32BIT_RANGE :
 #endif
             PROCESS_VIRTUAL_MMAP_RANGE;
-        u64 vaddr = process_get_virt_range_locked(p, len, alloc_region);
+        /* align anonymous mappings that may be backed by huge pages */
+        int align_order = (vmap_mmap_type == VMAP_MMAP_TYPE_ANONYMOUS && len >= PAGESIZE_2M &&
+                           (mmap_info.thp_mode == THP_ALWAYS || (vmflags & VMAP_FLAG_HUGEPAGE))) ?
+            PAGELOG_2M : PAGELOG;
+        u64 vaddr = process_get_virt_range_aligned_locked(p, len, align_order, alloc_region);
         if (vaddr == INVALID_PHYSICAL) {
             ret = -ENOMEM;
             thread_log(current, "   failed to get virtual address range");
@@ -1283,6 +1425,183 @@ static sysreturn munmap(void *addr, u64 length)
     return 0;
 }
 
+closure_function(1, 1, boolean, madvise_collect_phys,
+                 buffer, phys,
+                 range, r)
+{
+    /* the buffer is sized for the worst case, so this never reallocates */
+    assert(buffer_write(bound(phys), &r, sizeof(r)));
+    return true;
+}
+
+closure_function(2, 1, void, madvise_free_phys,
+                 id_heap, physical, buffer, phys,
+                 status, s)
+{
+    buffer phys = bound(phys);
+    range_handler rh = stack_closure(dealloc_phys_page, bound(physical));
+    range r;
+    while (buffer_read(phys, &r, sizeof(r)))
+        apply(rh, r);
+    deallocate_buffer(phys);
+    closure_finish();
+}
+
+/* Released pages are returned to the physical heap only after the TLB
+   shootdown has completed on all cpus. The range is released in chunks, each
+   with a buffer large enough to hold a range for every page in the chunk, so
+   that nothing needs to be freed while the page tables are being walked. */
+static boolean madvise_release_anonymous(range q)
+{
+    id_heap physical = mmap_info.physical;
+    while (range_span(q)) {
+        u64 len = MIN(range_span(q), MADVISE_RELEASE_CHUNK);
+        buffer phys = allocate_buffer(mmap_info.h, (len >> PAGELOG) * sizeof(range));
+        if (phys == INVALID_ADDRESS)
+            return false;
+        status_handler complete = closure(mmap_info.h, madvise_free_phys, physical, phys);
+        if (complete == INVALID_ADDRESS) {
+            deallocate_buffer(phys);
+            return false;
+        }
+        unmap_pages_with_complete(q.start, len, stack_closure(madvise_collect_phys, phys),
+                                  complete);
+        q.start += len;
+    }
+    return true;
+}
+
+closure_function(2, 1, boolean, madvise_release_vmap,
+                 range, q, int, advice,
+                 rmnode, node)
+{
+    vmap vm = (vmap)node;
+    range ri = range_intersection(bound(q), node->r);
+    /* only demand-paged mappings can be released */
+    if (!(vm->flags & VMAP_FLAG_MMAP))
+        return true;
+    switch (vm->flags & VMAP_MMAP_TYPE_MASK) {
+    case VMAP_MMAP_TYPE_ANONYMOUS:
+        return madvise_release_anonymous(ri);
+    case VMAP_MMAP_TYPE_FILEBACKED:
+        /* lazy freeing only applies to anonymous memory */
+        if (bound(advice) == MADV_DONTNEED)
+            pagecache_node_unmap_pages(vm->cache_node, ri,
+                                       vm->node_offset + (ri.start - node->r.start));
+        break;
+    }
+    return true;
+}
+
+static void madvise_willneed(process p, range q)
+{
+    while (range_span(q)) {
+        vmap_lock(p);
+        vmap vm = vmap_from_vaddr_locked(p, q.start);
+        if (vm == INVALID_ADDRESS) {
+            vmap_unlock(p);
+            break;
+        }
+        range ri = range_intersection(q, vm->node.r);
+        pagecache_node pn = 0;
+        fdesc fd = 0;
+        if ((vm->flags & VMAP_FLAG_MMAP) &&
+            (vm->flags & VMAP_MMAP_TYPE_MASK) == VMAP_MMAP_TYPE_FILEBACKED && vm->fd) {
+            pn = vm->cache_node;
+            fd = vm->fd;
+            fetch_and_add(&fd->refcnt, 1);
+        }
+        u64 node_offset = vm->node_offset + (ri.start - vm->node.r.start);
+        vmap_unlock(p);
+        if (pn) {
+            pagecache_node_fetch_pages(pn, irangel(node_offset, range_span(ri)));
+            fdesc_put(fd);
+        }
+        q.start = ri.end;
+    }
+}
+
+static void madvise_update_flags_locked(process p, range q, u32 mask, u32 newflags)
+{
+    /* updating flags can lead to merging of nodes, so we cannot traverse */
+    range r = q;
+    while (range_span(r)) {
+        vmap vm = (vmap)rangemap_lookup(p->vmaps, r.start);
+        vmap_assert(vm != INVALID_ADDRESS);
+        if (vm->flags & VMAP_FLAG_MMAP)
+            vmap_update_flags_intersection(p->vmaps, q, mask, newflags, vm);
+        r.start = MIN(r.end, vm->node.r.end);
+    }
+    vmap_paranoia_locked(p->vmaps);
+}
+
+closure_function(0, 1, boolean, madvise_gap,
+                 range, r)
+{
+    thread_log(current, "   found gap [0x%lx, 0x%lx)", r.start, r.end);
+    return false;
+}
+
+static sysreturn madvise(void *addr, u64 len, int advice)
+{
+    process p = current->p;
+    thread_log(current, "madvise: addr %p, len 0x%lx, advice %d", addr, len, advice);
+
+    u64 where = u64_from_pointer(addr);
+    if (where & MASK(PAGELOG))
+        return -EINVAL;
+    if (len == 0)
+        return 0;
+    range q = irangel(where, pad(len, PAGESIZE));
+    if (!validate_user_memory(addr, range_span(q), false))
+        return -ENOMEM;
+
+    vmap_lock(p);
+    if (rangemap_range_find_gaps(p->vmaps, q, stack_closure(madvise_gap)) == RM_ABORT) {
+        vmap_unlock(p);
+        return -ENOMEM;
+    }
+    switch (advice) {
+    case MADV_NORMAL:
+        madvise_update_flags_locked(p, q, VMAP_FLAG_SEQUENTIAL | VMAP_FLAG_RANDOM, 0);
+        break;
+    case MADV_SEQUENTIAL:
+        madvise_update_flags_locked(p, q, VMAP_FLAG_SEQUENTIAL | VMAP_FLAG_RANDOM,
+                                    VMAP_FLAG_SEQUENTIAL);
+        break;
+    case MADV_RANDOM:
+        madvise_update_flags_locked(p, q, VMAP_FLAG_SEQUENTIAL | VMAP_FLAG_RANDOM,
+                                    VMAP_FLAG_RANDOM);
+        break;
+    case MADV_HUGEPAGE:
+        if (mmap_info.thp_mode != THP_NEVER)
+            madvise_update_flags_locked(p, q, VMAP_FLAG_HUGEPAGE | VMAP_FLAG_NOHUGEPAGE,
+                                        VMAP_FLAG_HUGEPAGE);
+        break;
+    case MADV_NOHUGEPAGE:
+        madvise_update_flags_locked(p, q, VMAP_FLAG_HUGEPAGE | VMAP_FLAG_NOHUGEPAGE,
+                                    VMAP_FLAG_NOHUGEPAGE);
+        break;
+    case MADV_DONTNEED:
+    case MADV_FREE:
+        if (rangemap_range_lookup(p->vmaps, q,
+                                  stack_closure(madvise_release_vmap, q, advice)) == RM_ABORT) {
+            vmap_unlock(p);
+            return -EAGAIN;
+        }
+        break;
+    case MADV_WILLNEED:
+        vmap_unlock(p);
+        madvise_willneed(p, q);
+        return 0;
+    default:
+        /* other advice is accepted and ignored */
+        break;
+    }
+    vmap_unlock(p);
+    return 0;
+}
+
 /* kernel start */
 extern void * START;
 
@@ -1388,6 +1707,20 @@ void mmap_process_init(process p, tuple root)
     mmap_info.h = h;
     mmap_info.physical = heap_physical(kh);
     mmap_info.linear_backed = reserve_heap_wrapper(h, (heap)heap_linear_backed(kh), USER_MEMORY_RESERVE);
+    mmap_info.thp_mode = THP_ALWAYS;
+    string thp = get_string(root, sym(transparent_hugepage));
+    if (thp) {
+        if (buffer_compare_with_cstring(thp, "never"))
+            mmap_info.thp_mode = THP_NEVER;
+        else if (buffer_compare_with_cstring(thp, "madvise"))
+            mmap_info.thp_mode = THP_MADVISE;
+        else if (!buffer_compare_with_cstring(thp, "always"))
+            msg_err("invalid transparent_hugepage value \"%b\"; using \"always\"\n", thp);
+    }
+    u64 fault_around;
+    if (!get_u64(root, sym(fault_around), &fault_around))
+        fault_around = FAULT_AROUND_DEFAULT;
+    mmap_info.fault_around = fault_around >= PAGESIZE ? U64_FROM_BIT(msb(fault_around)) : 0;
     spin_lock_init(&p->vmap_lock);
     u64 min_addr;
     if (get_u64(root, sym(mmap_min_addr), &min_addr))
@@ -1442,5 +1775,5 @@ void register_mmap_syscalls(struct syscall *map)
     register_syscall(map, msync, msync, SYSCALL_F_SET_MEM);
     register_syscall(map, munmap, munmap, SYSCALL_F_SET_MEM);
     register_syscall(map, mprotect, mprotect, SYSCALL_F_SET_MEM);
-    register_syscall(map, madvise, syscall_ignore, SYSCALL_F_SET_MEM);
+    register_syscall(map, madvise, madvise, SYSCALL_F_SET_MEM);
 }
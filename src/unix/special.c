@@ -203,12 +203,54 @@ static u32 cpu_online_events(file f)
     return (EPOLLIN | EPOLLOUT);
 }
 
+static sysreturn sched_read(file f, void *dest, u64 length, u64 offset)
+{
+    buffer b = little_stack_buffer(128);
+    bprintf(b, "%s (%d)\n"
+               "se.nr_migrations : %ld\n",
+            current->name, current->tid, current->task.migrations);
+    return buffer_read_at(b, offset, dest, length);
+}
+
+static void sched_histogram_print(buffer b, const char *name, sched_histogram sh)
+{
+    bprintf(b, "%s", name);
+    for (int i = 0; i < SCHED_LATENCY_BUCKETS; i++)
+        bprintf(b, " %ld", sh->buckets[i]);
+    buffer_write_cstring(b, "\n");
+}
+
+/* per-cpu scheduler latency histograms, with bucket lower bounds in us */
+static sysreturn sched_latency_read(file f, void *dest, u64 length, u64 offset)
+{
+    heap h = heap_locked(get_kernel_heaps());
+    buffer b = allocate_buffer(h, 1024);
+    if (b == INVALID_ADDRESS)
+        return -ENOMEM;
+    buffer_write_cstring(b, "buckets 0");
+    for (int i = 1; i < SCHED_LATENCY_BUCKETS; i++)
+        bprintf(b, " %ld", U64_FROM_BIT(i - 1));
+    buffer_write_cstring(b, "\n");
+    for (u64 i = 0; i < total_processors; i++) {
+        cpuinfo ci = cpuinfo_from_id(i);
+        bprintf(b, "cpu%ld migrations %ld\n", i, ci->migrations);
+        sched_histogram_print(b, "runq_delay", &ci->runq_delay);
+        sched_histogram_print(b, "wakeup_latency", &ci->wakeup_latency);
+        sched_histogram_print(b, "slice_length", &ci->slice_length);
+    }
+    length = buffer_read_at(b, offset, dest, length);
+    deallocate_buffer(b);
+    return length;
+}
+
 static const special_file special_files[] = {
     { "/dev/urandom", .read = urandom_read, .write = 0, .events = urandom_events },
     { "/dev/null", .read = null_read, .write = null_write, .events = null_events },
     { "/proc/meminfo", .read = meminfo_read},
     { "/proc/mounts", .open = mounts_open, .close = mounts_close, .read = mounts_read, .events = mounts_events, .alloc_size = sizeof(struct mounts_notify_data)},
     { "/proc/self/maps", .read = maps_read, .events = maps_events, },
+    { "/proc/self/sched", .read = sched_read, },
+    { "/proc/sched_latency", .read = sched_latency_read, },
     { "/sys/devices/system/cpu/online", .read = cpu_online_read, .write = null_write, .events = cpu_online_events },
     FTRACE_SPECIAL_FILES
 };
@@ -2209,12 +2209,25 @@ sysreturn sched_setaffinity(int pid, u64 cpusetsize, u64 *mask)
     if (!(t = lookup_thread(pid)))
             return set_syscall_error(current, EINVAL);                
     u64 cpus = pad(MIN(total_processors, 64 * (cpusetsize / sizeof(u64))), 64);
+    u64 cpu;
+    for (cpu = 0; cpu < MIN(cpus, total_processors); cpu++)
+        if (mask[cpu / 64] & U64_FROM_BIT(cpu & 63))
+            break;
+    if (cpu >= MIN(cpus, total_processors)) {
+        thread_release(t);
+        return set_syscall_error(current, EINVAL);
+    }
     thread_lock(t);
     runtime_memcpy(bitmap_base(t->affinity), mask, cpus / 8);
     if (cpus < total_processors)
         bitmap_range_check_and_set(t->affinity, cpus, total_processors - cpus, false, false);
+    sched_task_affinity_update(&t->task);
     thread_unlock(t);
     thread_release(t);
+
+    /* migrate the calling thread if it may no longer run on this CPU */
+    if (t == current && !sched_task_allowed(&t->task, current_cpu()->id))
+        thread_yield();
     return 0;
 }
 
@@ -2234,6 +2247,134 @@ sysreturn sched_getaffinity(int pid, u64 cpusetsize, u64 *mask)
     return cpusetsize;
 }
 
+static boolean sched_policy_valid(int policy, int priority)
+{
+    switch (policy) {
+    case SCHED_FIFO:
+    case SCHED_RR:
+        return (priority >= 1) && (priority <= 99);
+    case SCHED_OTHER:
+    case SCHED_BATCH:
+    case SCHED_IDLE:
+        return priority == 0;
+    default:
+        return false;
+    }
+}
+
+static sysreturn sched_set(int pid, int policy, struct sched_param *param, boolean set_policy)
+{
+    if (pid < 0 || !param)
+        return -EINVAL;
+    if (!validate_user_memory(param, sizeof(struct sched_param), false))
+        return -EFAULT;
+    thread t;
+    if (!(t = lookup_thread(pid)))
+        return -ESRCH;
+    boolean reset_on_fork = false;
+    if (set_policy) {
+        reset_on_fork = (policy & SCHED_RESET_ON_FORK) != 0;
+        policy &= ~SCHED_RESET_ON_FORK;
+    } else {
+        policy = t->sched_policy;
+    }
+    sysreturn rv = 0;
+    if (!sched_policy_valid(policy, param->sched_priority)) {
+        rv = -EINVAL;
+        goto out;
+    }
+    thread_lock(t);
+    t->sched_policy = policy;
+    t->sched_priority = param->sched_priority;
+    if (set_policy)
+        t->sched_reset_on_fork = reset_on_fork;
+    thread_unlock(t);
+  out:
+    thread_release(t);
+    return rv;
+}
+
+sysreturn sched_setscheduler(int pid, int policy, struct sched_param *param)
+{
+    return sched_set(pid, policy, param, true);
+}
+
+sysreturn sched_setparam(int pid, struct sched_param *param)
+{
+    return sched_set(pid, 0, param, false);
+}
+
+sysreturn sched_getscheduler(int pid)
+{
+    if (pid < 0)
+        return -EINVAL;
+    thread t;
+    if (!(t = lookup_thread(pid)))
+        return -ESRCH;
+    sysreturn rv = t->sched_policy | (t->sched_reset_on_fork ? SCHED_RESET_ON_FORK : 0);
+    thread_release(t);
+    return rv;
+}
+
+sysreturn sched_getparam(int pid, struct sched_param *param)
+{
+    if (pid < 0 || !param)
+        return -EINVAL;
+    if (!validate_user_memory(param, sizeof(struct sched_param), true))
+        return -EFAULT;
+    thread t;
+    if (!(t = lookup_thread(pid)))
+        return -ESRCH;
+    param->sched_priority = t->sched_priority;
+    thread_release(t);
+    return 0;
+}
+
+sysreturn sched_get_priority_max(int policy)
+{
+    switch (policy) {
+    case SCHED_FIFO:
+    case SCHED_RR:
+        return 99;
+    case SCHED_OTHER:
+    case SCHED_BATCH:
+    case SCHED_IDLE:
+        return 0;
+    default:
+        return -EINVAL;
+    }
+}
+
+sysreturn sched_get_priority_min(int policy)
+{
+    switch (policy) {
+    case SCHED_FIFO:
+    case SCHED_RR:
+        return 1;
+    case SCHED_OTHER:
+    case SCHED_BATCH:
+    case SCHED_IDLE:
+        return 0;
+    default:
+        return -EINVAL;
+    }
+}
+
+sysreturn sched_rr_get_interval(int pid, struct timespec *tp)
+{
+    if (pid < 0)
+        return -EINVAL;
+    if (!validate_user_memory(tp, sizeof(struct timespec), true))
+        return -EFAULT;
+    thread t;
+    if (!(t = lookup_thread(pid)))
+        return -ESRCH;
+    timespec_from_time(tp, t->sched_policy == SCHED_RR ?
+                       microseconds(SCHED_RR_TIMESLICE_US) : 0);
+    thread_release(t);
+    return 0;
+}
+
 sysreturn capget(cap_user_header_t hdrp, cap_user_data_t datap)
 {
     if (datap) {
@@ -2382,6 +2523,13 @@ void register_file_syscalls(struct syscall *map)
     register_syscall(map, fchdir, fchdir, SYSCALL_F_SET_DESC);
     register_syscall(map, sched_getaffinity, sched_getaffinity, 0);
     register_syscall(map, sched_setaffinity, sched_setaffinity, 0);
+    register_syscall(map, sched_setscheduler, sched_setscheduler, 0);
+    register_syscall(map, sched_getscheduler, sched_getscheduler, 0);
+    register_syscall(map, sched_setparam, sched_setparam, 0);
+    register_syscall(map, sched_getparam, sched_getparam, 0);
+    register_syscall(map, sched_get_priority_max, sched_get_priority_max, 0);
+    register_syscall(map, sched_get_priority_min, sched_get_priority_min, 0);
+    register_syscall(map, sched_rr_get_interval, sched_rr_get_interval, 0);
     register_syscall(map, getuid, syscall_ignore, 0);
     register_syscall(map, geteuid, syscall_ignore, 0);
     register_syscall(map, setgroups, syscall_ignore, 0);
@@ -210,6 +210,15 @@ struct flock {
 #define MREMAP_MAYMOVE      1
 #define MREMAP_FIXED        2
 
+#define MADV_NORMAL         0
+#define MADV_RANDOM         1
+#define MADV_SEQUENTIAL     2
+#define MADV_WILLNEED       3
+#define MADV_DONTNEED       4
+#define MADV_FREE           8
+#define MADV_HUGEPAGE       14
+#define MADV_NOHUGEPAGE     15
+
 #define PROT_READ       0x1
 #define PROT_WRITE      0x2
 #define PROT_EXEC       0x4
@@ -674,6 +683,17 @@ struct tms {
 #define CLONE_NEWNET		0x40000000	/* New network namespace */
 #define CLONE_IO		0x80000000	/* Clone io context */
 
+#define SCHED_OTHER     0
+#define SCHED_FIFO      1
+#define SCHED_RR        2
+#define SCHED_BATCH     3
+#define SCHED_IDLE      5
+#define SCHED_RESET_ON_FORK 0x40000000
+
+struct sched_param {
+    int sched_priority;
+};
+
 struct clone_args_internal {
      u64 flags;
      int *child_tid;
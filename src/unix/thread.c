@@ -79,6 +79,11 @@ static sysreturn clone_internal(struct clone_args_internal *args)
 
      clone_frame_pstate(f, thread_frame(current));
      thread_clone_sigmask(t, current);
+     if (!current->sched_reset_on_fork) {
+          t->sched_policy = current->sched_policy;
+          t->sched_priority = current->sched_priority;
+          t->sched_reset_on_fork = false;
+     }
 
      set_syscall_return(t, 0);
      f[SYSCALL_FRAME_SP] = (u64)stack + stack_size;
@@ -216,6 +221,7 @@ static void thread_cputime_update(thread t)
         t->utime += diff;
         t->task.runtime = diff;
         t->start_time = 0;
+        sched_histogram_record(&current_cpu()->slice_length, diff);
         cputime_update(t, diff, true);
     }
 }
@@ -245,10 +251,30 @@ static void thread_resume(context ctx)
     frame_enable_interrupts(f);
 }
 
+/* Policy changes take effect when the thread is next scheduled, as the task
+   cannot be reordered while queued. */
+static void thread_sched_update(thread t)
+{
+    switch (t->sched_policy) {
+    case SCHED_FIFO:
+    case SCHED_RR:
+        sched_task_set_class(&t->task, SCHED_CLASS_RT, t->sched_priority,
+                             t->sched_policy == SCHED_RR);
+        break;
+    case SCHED_IDLE:
+        sched_task_set_class(&t->task, SCHED_CLASS_IDLE, 0, false);
+        break;
+    default:
+        sched_task_set_class(&t->task, SCHED_CLASS_FAIR, 0, false);
+        break;
+    }
+}
+
 static void thread_schedule_return(context ctx)
 {
     thread t = (thread)ctx;
     thread_cputime_update(t);   /* so that it is scheduled based on how much CPU time it used */
+    thread_sched_update(t);
     sched_enqueue(t->scheduling_queue, &t->task);
 }
 
@@ -282,9 +308,18 @@ define_closure_function(1, 0, void, thread_return,
     t->syscall = 0;
 
     /* If we migrated to a new CPU, remain on its thread queue. */
-    t->scheduling_queue = &ci->thread_queue;
+    if (t->scheduling_queue != &ci->thread_queue) {
+        t->task.migrations++;
+        ci->migrations++;
+        t->scheduling_queue = &ci->thread_queue;
+    }
     thread_unlock(t);
 
+    if (t->task.woken) {
+        sched_histogram_record(&ci->wakeup_latency, now(CLOCK_ID_MONOTONIC_RAW) - t->task.woken);
+        t->task.woken = 0;
+    }
+
     context_frame f = t->context.frame;
     assert(f[FRAME_FULL]);
     thread_trace(t, TRACE_THREAD_RUN, "run thread, cpu %d, frame %p, pc 0x%lx, sp 0x%lx, rv 0x%lx",
@@ -321,6 +356,7 @@ void thread_yield(void)
     thread_log(current, "yield %d, RIP=0x%lx", current->tid, thread_frame(current)[SYSCALL_FRAME_PC]);
     assert(!current->blocked_on);
     current->syscall = 0;
+    current->task.rt_order = 0; /* to the tail of its priority */
     set_syscall_return(current, 0);
     syscall_finish(false);
 }
@@ -339,6 +375,8 @@ void thread_wakeup(thread t)
     assert(t->blocked_on);
     t->blocked_on = 0;
     t->syscall = 0;
+    t->task.woken = now(CLOCK_ID_MONOTONIC_RAW);
+    t->task.rt_order = 0;       /* to the tail of its priority */
     context_release_refcount(sc);
     schedule_thread(t);
 }
@@ -462,6 +500,19 @@ thread create_thread(process p, u64 tid)
     if (t->affinity == INVALID_ADDRESS)
         goto fail_affinity;
     bitmap_range_check_and_set(t->affinity, 0, total_processors, false, true);
+    t->task.affinity = t->affinity;
+    t->task.pinned_cpu = -1;
+    t->task.migrations = 0;
+    t->task.enqueued = 0;
+    t->task.woken = 0;
+    t->task.sched_class = SCHED_CLASS_FAIR;
+    t->task.rt_priority = 0;
+    t->task.rr = false;
+    t->task.rt_order = 0;
+    t->task.rr_used = 0;
+    t->sched_policy = SCHED_OTHER;
+    t->sched_priority = 0;
+    t->sched_reset_on_fork = false;
     t->blocked_on = 0;
     t->syscall_complete = false;
     t->syscall_abandoned = false;
@@ -225,7 +225,7 @@ sysreturn timerfd_settime(int fd, int flags,
     if (interval != 0)
         ut->interval = true;
     reserve_unix_timer(ut);
-    register_timer(kernel_timers, &ut->t, ut->cid, tinit, absolute, interval,
+    register_timer(kernel_timerqueue(), &ut->t, ut->cid, tinit, absolute, interval,
                    init_closure(&ut->info.timerfd.timer_expire, timerfd_timer_expire, ut));
   out:
     spin_unlock(&ut->lock);
@@ -346,7 +346,7 @@ sysreturn timerfd_create(int clockid, int flags)
     if (flags & ~(TFD_NONBLOCK | TFD_CLOEXEC))
         return -EINVAL;
 
-    unix_timer ut = allocate_unix_timer(UNIX_TIMER_TYPE_TIMERFD, kernel_timers, clockid);
+    unix_timer ut = allocate_unix_timer(UNIX_TIMER_TYPE_TIMERFD, kernel_timerqueue(), clockid);
     if (ut == INVALID_ADDRESS)
         return -ENOMEM;
 
@@ -576,7 +576,7 @@ sysreturn timer_create(int clockid, struct sigevent *sevp, u32 *timerid)
             goto err_nomem;
         break;
     default:
-        tq = kernel_timers;
+        tq = kernel_timerqueue();
         break;
     }
     unix_timer ut = allocate_unix_timer(UNIX_TIMER_TYPE_POSIX, tq, clockid);
@@ -708,7 +708,7 @@ static unix_timer unix_timer_from_itimer_index(process p, int which)
     unix_timer ut = vector_get(p->itimers, which);
     if (!ut) {
         ut = allocate_unix_timer(UNIX_TIMER_TYPE_ITIMER,
-                                 (which == ITIMER_REAL) ? kernel_timers : p->cpu_timers,
+                                 (which == ITIMER_REAL) ? kernel_timerqueue() : p->cpu_timers,
                                  CLOCK_ID_MONOTONIC);
         if (ut == INVALID_ADDRESS)
             return ut;
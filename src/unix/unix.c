@@ -563,7 +563,8 @@ process init_unix(kernel_heaps kh, tuple root, filesystem fs)
             size *= GB;
         coredump_set_limit(size);
     }
-    assert(mm_register_mem_cleaner(init_closure(&uh->mem_cleaner, unix_mem_cleaner)));
+    assert(mm_register_mem_cleaner(init_closure(&uh->mem_cleaner, unix_mem_cleaner),
+                                   "unix", MEM_CLEAN_COST_IDLE));
 out:
     return kernel_process;
   alloc_fail:
@@ -13,6 +13,10 @@
 
 #define VMAP_FLAG_MMAP     0x0010
 #define VMAP_FLAG_SHARED   0x0020 /* vs private; same semantics as unix */
+#define VMAP_FLAG_HUGEPAGE 0x0040 /* back with huge pages where possible */
+#define VMAP_FLAG_NOHUGEPAGE 0x0080
+#define VMAP_FLAG_SEQUENTIAL 0x1000 /* access pattern hints from madvise */
+#define VMAP_FLAG_RANDOM     0x2000
 
 #define VMAP_MMAP_TYPE_MASK       0x0f00
 #define VMAP_MMAP_TYPE_ANONYMOUS  0x0100
@@ -343,6 +347,9 @@ typedef struct thread {
     u64 signal_stack_length;
 
     bitmap affinity;
+    int sched_policy;           /* applied to task when next scheduled */
+    int sched_priority;
+    boolean sched_reset_on_fork;
     struct list l_faultwait;
     struct spinlock lock;   /* generic lock for struct members without a specific lock */
 
@@ -402,6 +409,8 @@ typedef struct fdesc {
 #define IOV_MAX 1024
 
 #define FILE_READAHEAD_DEFAULT  (128 * KB)
+#define FAULT_AROUND_DEFAULT    (64 * KB)
+#define MADVISE_RELEASE_CHUNK   (16 * MB)
 
 struct file {
     struct fdesc f;             /* must be first */
@@ -34,6 +34,16 @@
 #define VIRTIO_BALLOON_F_MUST_TELL_HOST 1
 #define VIRTIO_BALLOON_F_STATS_VQ       2
 #define VIRTIO_BALLOON_F_DEFLATE_ON_OOM 4
+#define VIRTIO_BALLOON_F_REPORTING      0x20
+
+/* Free page reporting: free physical memory is reported to the host in
+   balloon-page-sized chunks, a batch at a time, in sweeps across the physical
+   heap. Chunks that were reported and found free again in later sweeps are
+   skipped, except on every VIRTIO_BALLOON_REPORT_FULL_SWEEP-th sweep, as they
+   may have been used and freed in the meantime. */
+#define VIRTIO_BALLOON_REPORT_CAPACITY      32
+#define VIRTIO_BALLOON_REPORT_INTERVAL_SEC  30
+#define VIRTIO_BALLOON_REPORT_FULL_SWEEP    8
 
 struct virtio_balloon_stat {
 #define VIRTIO_BALLOON_S_SWAP_IN      0
@@ -55,6 +65,10 @@ struct virtio_balloon_stat {
 
 declare_closure_struct(0, 2, void, virtio_balloon_timer_task,
                        u64, expiry, u64, overruns);
+declare_closure_struct(0, 2, void, virtio_balloon_report_task,
+                       u64, expiry, u64, overruns);
+declare_closure_struct(0, 1, void, virtio_balloon_report_complete,
+                       u64, len);
 struct virtio_balloon {
     heap general;
     backed_heap backed;
@@ -71,6 +85,17 @@ struct virtio_balloon {
     u32 actual_pages;
     struct list in_balloon;
     struct list free;
+
+    /* free page reporting */
+    virtqueue reportq;
+    struct timer report_timer;
+    closure_struct(virtio_balloon_report_task, report_task);
+    closure_struct(virtio_balloon_report_complete, report_complete);
+    bitmap reported;            /* by chunk */
+    u64 report_cursor;
+    int report_sweep;
+    int report_count;
+    u64 report_chunks[VIRTIO_BALLOON_REPORT_CAPACITY];
 } virtio_balloon;
 
 typedef struct balloon_page {
@@ -98,6 +123,11 @@ static inline boolean balloon_has_stats_vq(void)
     return (virtio_balloon.dev->features & VIRTIO_BALLOON_F_STATS_VQ) != 0;
 }
 
+static inline boolean balloon_has_reporting(void)
+{
+    return (virtio_balloon.dev->features & VIRTIO_BALLOON_F_REPORTING) != 0;
+}
+
 static u64 phys_base_from_balloon_page(balloon_page bp)
 {
     return bp->addrs[0] << VIRTIO_BALLOON_PAGE_ORDER;
@@ -224,7 +254,7 @@ static u64 virtio_balloon_deflate(u64 n_balloon_pages)
 
 void virtio_balloon_update(void)
 {
-    remove_timer(kernel_timers, &virtio_balloon.retry_timer, 0);
+    remove_timer(kernel_timerqueue(), &virtio_balloon.retry_timer, 0);
 
     u32 num_pages = le32toh(vtdev_cfg_read_4(virtio_balloon.dev, VIRTIO_BALLOON_R_NUM_PAGES));
     virtio_balloon_debug("%s: num_pages %d, actual %d\n", __func__, num_pages,
@@ -240,7 +270,7 @@ void virtio_balloon_update(void)
         if (inflated < inflate) {
             virtio_balloon_debug("   %ld balloon pages left to inflate\n", inflate - inflated);
             virtio_balloon_debug("   starting timer\n");
-            register_timer(kernel_timers, &virtio_balloon.retry_timer, CLOCK_ID_MONOTONIC,
+            register_timer(kernel_timerqueue(), &virtio_balloon.retry_timer, CLOCK_ID_MONOTONIC,
                            seconds(VIRTIO_BALLOON_RETRY_INTERVAL_SEC),
                            false, 0, (timer_handler)&virtio_balloon.timer_task);
         }
@@ -347,6 +377,111 @@ define_closure_function(0, 2, void, virtio_balloon_timer_task,
     }
 }
 
+static void virtio_balloon_report_start_timer(void)
+{
+    register_timer(kernel_timerqueue(), &virtio_balloon.report_timer, CLOCK_ID_MONOTONIC,
+                   seconds(VIRTIO_BALLOON_REPORT_INTERVAL_SEC), false, 0,
+                   (timer_handler)&virtio_balloon.report_task);
+}
+
+/* chunks between the cursor and the next free chunk are in use */
+static void virtio_balloon_report_clear_range(u64 start, u64 end)
+{
+    bitmap b = virtio_balloon.reported;
+    end = MIN(end, b->mapbits);
+    for (u64 i = start; i < end; i++) {
+        if (bitmap_get(b, i))
+            bitmap_set(b, i, 0);
+    }
+}
+
+static void virtio_balloon_report_next(void)
+{
+    virtqueue vq = virtio_balloon.reportq;
+    id_heap physical = virtio_balloon.physical;
+    boolean full_sweep = virtio_balloon.report_sweep == 0;
+    int capacity = MIN(VIRTIO_BALLOON_REPORT_CAPACITY, virtqueue_entries(vq));
+    boolean sweep_done = false;
+    assert(virtio_balloon.report_count == 0);
+    while (virtio_balloon.report_count < capacity) {
+        /* don't push the kernel into reclaiming memory */
+        if (heap_free((heap)physical) < MEM_CLEAN_THRESHOLD + VIRTIO_BALLOON_ALLOC_SIZE)
+            break;
+        u64 cursor = virtio_balloon.report_cursor;
+        u64 chunk = id_heap_alloc_gte(physical, VIRTIO_BALLOON_ALLOC_SIZE, cursor);
+        if (chunk == INVALID_PHYSICAL) {
+            virtio_balloon_report_clear_range(cursor >> VIRTIO_BALLOON_ALLOC_ORDER, infinity);
+            sweep_done = true;
+            break;
+        }
+        u64 index = chunk >> VIRTIO_BALLOON_ALLOC_ORDER;
+        virtio_balloon_report_clear_range(cursor >> VIRTIO_BALLOON_ALLOC_ORDER, index);
+        virtio_balloon.report_cursor = chunk + VIRTIO_BALLOON_ALLOC_SIZE;
+        if (!full_sweep && bitmap_get(virtio_balloon.reported, index)) {
+            deallocate_u64((heap)physical, chunk, VIRTIO_BALLOON_ALLOC_SIZE);
+            continue;
+        }
+        virtio_balloon.report_chunks[virtio_balloon.report_count++] = chunk;
+    }
+    int count = virtio_balloon.report_count;
+    if (count == 0) {
+        if (sweep_done) {
+            virtio_balloon_debug("%s: sweep done\n", __func__);
+            virtio_balloon.report_cursor = 0;
+            virtio_balloon.report_sweep = (virtio_balloon.report_sweep + 1) %
+                VIRTIO_BALLOON_REPORT_FULL_SWEEP;
+        }
+        virtio_balloon_report_start_timer();
+        return;
+    }
+    virtio_balloon_debug("%s: reporting %d chunks up to 0x%lx\n", __func__, count,
+                         virtio_balloon.report_cursor);
+    vqmsg m = allocate_vqmsg(vq);
+    assert(m != INVALID_ADDRESS);
+    for (int i = 0; i < count; i++)
+        vqmsg_push(vq, m, virtio_balloon.report_chunks[i], VIRTIO_BALLOON_ALLOC_SIZE, true);
+    vqmsg_commit(vq, m, (vqfinish)&virtio_balloon.report_complete);
+}
+
+define_closure_function(0, 1, void, virtio_balloon_report_complete,
+                        u64, len)
+{
+    /* the host has discarded the chunks; they can now be reused */
+    for (int i = 0; i < virtio_balloon.report_count; i++) {
+        u64 chunk = virtio_balloon.report_chunks[i];
+        bitmap_set(virtio_balloon.reported, chunk >> VIRTIO_BALLOON_ALLOC_ORDER, 1);
+        deallocate_u64((heap)virtio_balloon.physical, chunk, VIRTIO_BALLOON_ALLOC_SIZE);
+    }
+    virtio_balloon.report_count = 0;
+    virtio_balloon_report_next();
+}
+
+define_closure_function(0, 2, void, virtio_balloon_report_task,
+                        u64, expiry, u64, overruns)
+{
+    if (overruns != timer_disabled)
+        virtio_balloon_report_next();
+}
+
+static status virtio_balloon_init_reporting(heap general, vtdev v)
+{
+    /* queues of features not negotiated are skipped in numbering */
+    int idx = balloon_has_stats_vq() ? 3 : 2;
+    status s = virtio_alloc_virtqueue(v, "virtio balloon reportq", idx, &virtio_balloon.reportq);
+    if (!is_ok(s))
+        return s;
+    virtio_balloon.reported = allocate_bitmap(general, general, infinity);
+    if (virtio_balloon.reported == INVALID_ADDRESS)
+        return timm("result", "failed to allocate bitmap");
+    virtio_balloon.report_cursor = 0;
+    virtio_balloon.report_sweep = 0;
+    virtio_balloon.report_count = 0;
+    init_timer(&virtio_balloon.report_timer);
+    init_closure(&virtio_balloon.report_task, virtio_balloon_report_task);
+    init_closure(&virtio_balloon.report_complete, virtio_balloon_report_complete);
+    return STATUS_OK;
+}
+
 static boolean virtio_balloon_attach(heap general, backed_heap backed, id_heap physical, vtdev v)
 {
     virtio_balloon_debug("   dev_features 0x%lx, features 0x%lx\n",
@@ -382,16 +517,25 @@ static boolean virtio_balloon_attach(heap general, backed_heap backed, id_heap p
     } else {
         virtio_balloon.statsq = 0;
     }
+    if (balloon_has_reporting()) {
+        s = virtio_balloon_init_reporting(general, v);
+        if (!is_ok(s))
+            goto fail;
+    } else {
+        virtio_balloon.reportq = 0;
+    }
     virtio_balloon_debug("   virtqueues allocated, setting driver status OK\n");
     vtdev_set_status(v, VIRTIO_CONFIG_STATUS_DRIVER_OK);
     update_actual_pages(0);
     virtio_balloon_update();
     mem_cleaner bd = closure(general, virtio_balloon_deflater);
     assert(bd != INVALID_ADDRESS);
-    if (!mm_register_mem_cleaner(bd))
+    if (!mm_register_mem_cleaner(bd, "virtio_balloon", MEM_CLEAN_COST_RESERVE))
         deallocate_closure(bd);
     if (balloon_has_stats_vq())
         virtio_balloon_init_statsq();
+    if (balloon_has_reporting())
+        virtio_balloon_report_start_timer();
     return true;
   fail:
     rprintf("%s: failed to attach: %v\n", __func__, s);
@@ -409,7 +553,8 @@ closure_function(3, 1, boolean, vtpci_balloon_probe,
     virtio_balloon_debug("   attaching\n", __func__);
     vtdev v = (vtdev)attach_vtpci(bound(general), bound(backed), d,
                                   (VIRTIO_BALLOON_F_STATS_VQ |
-                                   VIRTIO_BALLOON_F_MUST_TELL_HOST));
+                                   VIRTIO_BALLOON_F_MUST_TELL_HOST |
+                                   VIRTIO_BALLOON_F_REPORTING));
     return virtio_balloon_attach(bound(general), bound(backed), bound(physical), v);
 }
 
@@ -307,7 +307,8 @@ static void virtio_net_attach(vtdev dev)
     virtio_net_debug("%s: net_header_len %d, rxbuflen %d\n", __func__, vn->net_header_len, vn->rxbuflen);
     vn->rxbuffers = allocate_objcache(h, (heap)contiguous, vn->rxbuflen + sizeof(struct xpbuf),
                                       PAGESIZE_2M, true);
-    mm_register_mem_cleaner(init_closure(&vn->mem_cleaner, vnet_mem_cleaner));
+    mm_register_mem_cleaner(init_closure(&vn->mem_cleaner, vnet_mem_cleaner),
+                            "virtio_net", MEM_CLEAN_COST_IDLE);
     /* rx = 0, tx = 1, ctl = 2 by 
        page 53 of http://docs.oasis-open.org/virtio/virtio/v1.0/cs01/virtio-v1.0-cs01.pdf */
     vn->dev = dev;
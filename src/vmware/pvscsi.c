@@ -536,7 +536,8 @@ static void pvscsi_attach(heap general, storage_attach a, heap page_allocator, p
     // setup hcb cache
     dev->hcb_objcache = allocate_objcache(dev->general, page_allocator,
                                           sizeof(struct pvscsi_hcb), PAGESIZE_2M, true);
-    mm_register_mem_cleaner(init_closure(&dev->mem_cleaner, pvscsi_mem_cleaner));
+    mm_register_mem_cleaner(init_closure(&dev->mem_cleaner, pvscsi_mem_cleaner),
+                            "pvscsi", MEM_CLEAN_COST_IDLE);
 
     dev->adapter_queue_size = cmd.req_ring_num_pages * PAGESIZE / sizeof(struct pvscsi_ring_req_desc);
     dev->adapter_queue_size = MIN(dev->adapter_queue_size, PVSCSI_MAX_REQ_QUEUE_DEPTH);
@@ -379,7 +379,8 @@ static void vmxnet3_net_attach(heap general, heap page_allocator, pci_dev d)
     vn->rxbuffers = allocate_objcache(dev->general, page_allocator,
                                       vn->rxbuflen + sizeof(struct xpbuf), PAGESIZE_2M, true);
     assert(vn->rxbuffers != INVALID_ADDRESS);
-    mm_register_mem_cleaner(init_closure(&vn->mem_cleaner, vmxnet3_mem_cleaner));
+    mm_register_mem_cleaner(init_closure(&vn->mem_cleaner, vmxnet3_mem_cleaner),
+                            "vmxnet3", MEM_CLEAN_COST_IDLE);
 
     dev->vmx_ds = allocate_zero(dev->contiguous, sizeof(struct vmxnet3_driver_shared));
     assert(dev->vmx_ds != INVALID_ADDRESS);
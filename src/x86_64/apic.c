@@ -61,6 +61,28 @@ void apic_ipi(u64 target, u64 flags, u8 vector)
     apic_if->ipi(apic_if, apicid_from_cpuid(target), flags, vector);
 }
 
+/* With logical destinations, one ICR write reaches every target in an x2APIC
+   cluster; otherwise fall back to one IPI per target. */
+void apic_ipi_mask(bitmap targets, u64 flags, u8 vector)
+{
+    if (!apic_if->logical_id) {
+        bitmap_foreach_set(targets, i)
+            apic_if->ipi(apic_if, apicid_from_cpuid(i), flags, vector);
+        return;
+    }
+    u32 dest = 0;
+    bitmap_foreach_set(targets, i) {
+        u32 lid = apic_if->logical_id(apic_if, apicid_from_cpuid(i));
+        if (dest && (dest >> 16) != (lid >> 16)) {
+            apic_if->ipi(apic_if, dest, flags | ICR_LOGICAL, vector);
+            dest = 0;
+        }
+        dest |= lid;
+    }
+    if (dest)
+        apic_if->ipi(apic_if, dest, flags | ICR_LOGICAL, vector);
+}
+
 static inline void apic_set(int reg, u32 v)
 {
     apic_write(reg, apic_read(reg) | v);
@@ -242,13 +264,20 @@ void ioapic_register_int(unsigned int gsi, thunk h, const char *name)
         ioapic_set_int(gsi, v);
 }
 
-int cpuid_from_apicid(u32 aid)
+int apic_lookup_cpuid(u32 aid)
 {
     for (int i = 0; i < present_processors; i++) {
         if (aid == apicid_from_cpuid(i))
             return i;
     }
-    assert(0);
+    return -1;
+}
+
+int cpuid_from_apicid(u32 aid)
+{
+    int cpu = apic_lookup_cpuid(aid);
+    assert(cpu >= 0);
+    return cpu;
 }
 
 closure_function(1, 2, void, apic_madt_handler,
@@ -55,6 +55,7 @@ typedef struct apic_iface {
     void (*ipi)(struct apic_iface *, u32 target, u64 flags, u8 vector);
     boolean (*detect)(struct apic_iface *, kernel_heaps kh);
     void (*per_cpu_init)(struct apic_iface *);
+    u32 (*logical_id)(struct apic_iface *, u32 apic_id);   /* null if no logical multicast */
 } *apic_iface;
 
 void lapic_eoi(void);
@@ -62,8 +63,10 @@ void init_apic(kernel_heaps kh);
 void lapic_set_tsc_deadline_mode(u32 v);
 boolean init_lapic_timer(clock_timer *ct, thunk *per_cpu_init);
 void apic_ipi(u64 target, u64 flags, u8 vector);
+void apic_ipi_mask(bitmap targets, u64 flags, u8 vector);
 void apic_per_cpu_init(void);
 void apic_enable(void);
+int apic_lookup_cpuid(u32 aid);
 int cpuid_from_apicid(u32 aid);
 
 void ioapic_set_int(unsigned int gsi, u64 v);
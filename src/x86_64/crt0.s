@@ -65,18 +65,31 @@ extern use_xsave
         jmp %%out
 %%xs:
         mov edx, 0xffffffff
+        cmp al, 2               ; xsaveopt: skip state unmodified since xrstor
         mov eax, edx
+        jne %%full
+        xsaveopt [rcx]
+        jmp %%out
+%%full:
         xsave [rcx]
 %%out:
 %endmacro
 
         
       
-;;;  helper so userspace can save a frame without
-;;; 
+;;;  always does a complete xsave/fxsave; used to initialize new frames
 global xsave        
 xsave:
-        save_extended_registers rdi
+        mov rcx, [rdi+FRAME_EXTENDED*8]
+        mov al, [use_xsave]
+        test al, al
+        jnz .xs
+        fxsave [rcx]
+        ret
+.xs:
+        mov edx, 0xffffffff
+        mov eax, edx
+        xsave [rcx]
         ret
         
 ;; stack frame upon entry:
@@ -31,6 +31,11 @@ void send_ipi(u64 cpu, u8 vector)
     apic_ipi(cpu, ICR_ASSERT, vector);
 }
 
+void send_ipi_mask(bitmap targets, u8 vector)
+{
+    apic_ipi_mask(targets, ICR_ASSERT, vector);
+}
+
 void interrupt_exit(void)
 {
     lapic_eoi();
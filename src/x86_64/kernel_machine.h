@@ -213,6 +213,8 @@ extern void write_xmsr(u64, u64);
 /* CPUID level 7 (EBX) */
 #define CPUID_FSGSBASE  (1 << 0)
 
+extern boolean use_invpcid;
+
 static inline void cpuid(u32 fn, u32 ecx, u32 * v)
 {
     asm volatile("cpuid" : "=a" (v[0]), "=b" (v[1]), "=c" (v[2]), "=d" (v[3]) : "0" (fn), "2" (ecx));
@@ -320,8 +322,16 @@ static inline cpuinfo current_cpu(void)
     return (cpuinfo)pointer_from_u64(addr);
 }
 
+extern u8 use_xsave;
 extern u64 extended_frame_size;
 
+/* XSAVE area: legacy region and header, then components 2 and up */
+#define XSAVE_LEGACY_SIZE       512
+#define XSAVE_HEADER_SIZE       64
+#define XSTATE_FIRST_EXTENDED   2
+#define XSTATE_COMPONENTS       32
+extern u32 xstate_component_size[XSTATE_COMPONENTS];
+
 static inline boolean frame_is_full(context_frame f)
 {
     return f[FRAME_FULL];
@@ -29,14 +29,20 @@ static void (*start_callback)();
 
 /* CPUID level 7 (EBX) */
 #define CPUID_SMEP  (1<<7)
+#define CPUID_ERMS  (1<<9)
+#define CPUID_INVPCID (1<<10)
 
 /* CPUID level 7 (ECX) */
 #define CPUID_UMIP  (1<<2)
 
+/* CPUID level 0xd, subleaf 1 (EAX) */
+#define CPUID_XSAVEOPT (1<<0)
+
 #define XCR0_SSE (1<<1)
 #define XCR0_AVX (1<<2)
-u8 use_xsave;
+u8 use_xsave;   /* 1: xsave, 2: xsaveopt */
 u64 extended_frame_size = 512;
+u32 xstate_component_size[XSTATE_COMPONENTS];
 
 void init_cpu_features()
 {
@@ -56,6 +62,10 @@ void init_cpu_features()
         cr |= CR4_FSGSBASE;
     if (v[1] & CPUID_SMEP)
         cr |= CR4_SMEP;
+    if (v[1] & CPUID_ERMS)
+        memops_erms = true;
+    if (v[1] & CPUID_INVPCID)
+        use_invpcid = true;
     if (v[2] & CPUID_UMIP)
         cr |= CR4_UMIP;
     mov_to_cr("cr4", cr);
@@ -69,8 +79,18 @@ void init_cpu_features()
         if (avx)
             v[0] |= XCR0_AVX;
         xsetbv(0, v[0], v[1]);
+        u32 xcr0 = v[0];
         cpuid(0xd, 0, v);
         extended_frame_size = v[1];
+        for (int i = XSTATE_FIRST_EXTENDED; i < XSTATE_COMPONENTS; i++) {
+            if (xcr0 & U64_FROM_BIT(i)) {
+                cpuid(0xd, i, v);
+                xstate_component_size[i] = v[0];
+            }
+        }
+        cpuid(0xd, 1, v);
+        if (v[0] & CPUID_XSAVEOPT)
+            use_xsave = 2;
     }
 }
 
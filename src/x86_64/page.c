@@ -1,22 +1,58 @@
 #include <kernel.h>
 
 BSS_RO_AFTER_INIT u64 pagebase;
+boolean use_invpcid;
+
+#define INVPCID_SINGLE_CONTEXT      1
+#define INVPCID_ALL_CONTEXT_GLOBAL  2
+
+static inline void invpcid(u64 type, u64 pcid, u64 addr)
+{
+    struct {
+        u64 pcid;
+        u64 addr;
+    } desc = { pcid, addr };
+    asm volatile("invpcid %0, %1" :: "m" (desc), "r" (type) : "memory");
+}
 
 void invalidate(u64 page)
 {
     asm volatile("invlpg (%0)" :: "r" ((word)page) : "memory");
 }
 
-/* assumes page table is consistent when called */
-void flush_tlb(boolean full_flush)
+/* Drops all translations except global (kernel) ones. PCIDs aren't enabled, so
+   everything is tagged with PCID 0. */
+void flush_tlb_user(void)
 {
-    if (full_flush) {
+    if (use_invpcid) {
+        invpcid(INVPCID_SINGLE_CONTEXT, 0, 0);
+    } else {
         u64 *base;
         mov_from_cr("cr3", base);
         mov_to_cr("cr3", base);
     }
 }
 
+/* assumes page table is consistent when called */
+void flush_tlb(boolean full_flush)
+{
+    if (!full_flush)
+        return;
+    if (use_invpcid) {
+        invpcid(INVPCID_ALL_CONTEXT_GLOBAL, 0, 0);
+        return;
+    }
+    u64 cr4;
+    mov_from_cr("cr4", cr4);
+    if (cr4 & CR4_PGE) {
+        /* toggling PGE flushes global translations as well */
+        mov_to_cr("cr4", cr4 & ~CR4_PGE);
+        mov_to_cr("cr4", cr4);
+    } else {
+        flush_tlb_user();
+    }
+}
+
 #ifdef BOOT
 void page_invalidate(flush_entry f, u64 address)
 {
@@ -2,6 +2,7 @@
 
 #define PAGE_NO_EXEC       U64_FROM_BIT(63)
 #define PAGE_NO_PS         0x0200 /* AVL[0] */
+#define PAGE_GLOBAL        0x0100
 #define PAGE_PS            0x0080
 #define PAGE_DIRTY         0x0040
 #define PAGE_ACCESSED      0x0020
@@ -90,6 +91,12 @@ static inline pageflags pageflags_default_user(void)
     return pageflags_user(pageflags_minpage(pageflags_memory()));
 }
 
+/* Kernel mappings are global so that flushing user translations keeps them. */
+static inline pageflags pageflags_for_address(pageflags flags, u64 vaddr)
+{
+    return (pageflags){.w = vaddr >= USER_LIMIT ? flags.w | PAGE_GLOBAL : flags.w};
+}
+
 static inline boolean pageflags_is_present(pageflags flags)
 {
     return (flags.w & PAGE_PRESENT) != 0;
@@ -150,7 +157,8 @@ static inline pageflags pageflags_from_pte(pte pte)
 
 static inline u64 page_pte(u64 phys, u64 flags)
 {
-    return phys | (flags & ~PAGE_NO_PS) | PAGE_PRESENT;
+    /* PAGE_PS would be the PAT bit in a page entry */
+    return phys | (flags & ~(PAGE_NO_PS | PAGE_PS)) | PAGE_PRESENT;
 }
 
 static inline u64 block_pte(u64 phys, u64 flags)
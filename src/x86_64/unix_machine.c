@@ -240,6 +240,23 @@ u64 fpreg_size(void)
     return MIN(FPREG_SIZE, extended_frame_size);
 }
 
+/* Counts the components that were live at the save, per the XSTATE_BV field
+   of the header. */
+void thread_frame_save_fpsimd(context_frame f)
+{
+    cpuinfo ci = current_cpu();
+    u64 bytes = XSAVE_LEGACY_SIZE;
+    if (use_xsave) {
+        u64 xstate_bv = *(u64 *)(frame_extended(f) + XSAVE_LEGACY_SIZE);
+        bytes += XSAVE_HEADER_SIZE;
+        xstate_bv &= MASK(XSTATE_COMPONENTS) & ~MASK(XSTATE_FIRST_EXTENDED);
+        bitmap_word_foreach_set(xstate_bv, bit, i, 0)
+            bytes += xstate_component_size[i];
+    }
+    ci->fp_saves++;
+    ci->fp_save_bytes += bytes;
+}
+
 void fpreg_copy_out(void *b, thread t)
 {
     runtime_memcpy(b, pointer_from_u64(t->context.frame[FRAME_EXTENDED]),
@@ -295,13 +312,6 @@ void register_other_syscalls(struct syscall *map)
     register_syscall(map, sysfs, 0, 0);
     register_syscall(map, getpriority, 0, 0);
     register_syscall(map, setpriority, 0, 0);
-    register_syscall(map, sched_setparam, 0, 0);
-    register_syscall(map, sched_getparam, 0, 0);
-    register_syscall(map, sched_setscheduler, 0, 0);
-    register_syscall(map, sched_getscheduler, 0, 0);
-    register_syscall(map, sched_get_priority_max, 0, 0);
-    register_syscall(map, sched_get_priority_min, 0, 0);
-    register_syscall(map, sched_rr_get_interval, 0, 0);
     register_syscall(map, mlock, syscall_ignore, 0);
     register_syscall(map, munlock, syscall_ignore, 0);
     register_syscall(map, mlockall, syscall_ignore, 0);
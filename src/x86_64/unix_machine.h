@@ -250,8 +250,9 @@ static inline void syscall_restart_arch_fixup(context_frame f)
     f[FRAME_RIP] -= 2; /* rewind to syscall */
 }
 
-/* stubs, for intel sdm recommends using xsave* over manual lazy save/restore */
-#define thread_frame_save_fpsimd(f) ((void)f)
+/* The extended state is saved with xsave* on every kernel entry, as the intel
+   sdm recommends over manual lazy save/restore; only account for it here. */
+void thread_frame_save_fpsimd(context_frame f);
 #define thread_frame_restore_fpsimd(f) ((void)f)
 
 /* ignore these unless moving fs/gs save out of entry */
@@ -78,6 +78,13 @@ static void per_cpu_init(apic_iface i)
                  x2apic_read(i, APIC_APICVER));
 }
 
+/* The logical destination register is read-only in x2APIC mode and derived
+   from the APIC ID: cluster in the high 16 bits, one bit per member below. */
+static u32 x2apic_logical_id(apic_iface i, u32 apic_id)
+{
+    return ((apic_id >> 4) << 16) | (1 << (apic_id & 0xf));
+}
+
 const struct apic_iface x2apic_if = {
     "x2apic",
     x2apic_get_id,
@@ -85,5 +92,6 @@ const struct apic_iface x2apic_if = {
     x2apic_read,
     x2apic_ipi,
     detect,
-    per_cpu_init
+    per_cpu_init,
+    x2apic_logical_id
 };
@@ -87,5 +87,6 @@ const struct apic_iface xapic_if = {
     xapic_ipi,
     detect,
     0,                          /* per_cpu_init, n/a */
+    0,                          /* logical_id, flat model not set up */
 };
 
@@ -976,6 +976,50 @@ void mprotect_test(void)
     __munmap(addr, 5 * PAGESIZE);
 }
 
+static void madvise_test(void)
+{
+    u8 *addr;
+
+    printf("** starting madvise tests\n");
+    addr = mmap(NULL, 4 * PAGESIZE, PROT_READ | PROT_WRITE,
+            MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (addr == MAP_FAILED)
+        handle_err("madvise test: mmap");
+    memset(addr, 0xff, 4 * PAGESIZE);
+
+    /* released pages must read back as zero; neighbors must be untouched */
+    if (madvise(addr + PAGESIZE, PAGESIZE, MADV_DONTNEED) < 0)
+        handle_err("madvise(MADV_DONTNEED)");
+    if (madvise(addr + 2 * PAGESIZE, PAGESIZE, MADV_FREE) < 0)
+        handle_err("madvise(MADV_FREE)");
+    for (int i = 0; i < 4 * PAGESIZE; i++) {
+        u8 expected = (i >= PAGESIZE && i < 3 * PAGESIZE) ? 0 : 0xff;
+        if (addr[i] != expected)
+            fail_exit("byte at offset %d is 0x%x, expected 0x%x\n", i, addr[i], expected);
+    }
+
+    if (madvise(addr, 4 * PAGESIZE, MADV_SEQUENTIAL) < 0)
+        handle_err("madvise(MADV_SEQUENTIAL)");
+    if (madvise(addr + PAGESIZE, PAGESIZE, MADV_RANDOM) < 0)
+        handle_err("madvise(MADV_RANDOM)");
+    if (madvise(addr, 4 * PAGESIZE, MADV_NORMAL) < 0)
+        handle_err("madvise(MADV_NORMAL)");
+    if (madvise(addr, 4 * PAGESIZE, MADV_WILLNEED) < 0)
+        handle_err("madvise(MADV_WILLNEED)");
+
+    if (madvise(addr + 1, PAGESIZE, MADV_DONTNEED) == 0)
+        fail_exit("madvise with unaligned address should have failed\n");
+    else if (errno != EINVAL)
+        handle_err("madvise with unaligned address: unexpected error");
+    __munmap(addr + 3 * PAGESIZE, PAGESIZE);
+    if (madvise(addr, 4 * PAGESIZE, MADV_DONTNEED) == 0)
+        fail_exit("madvise over unmapped range should have failed\n");
+    else if (errno != ENOMEM)
+        handle_err("madvise over unmapped range: unexpected error");
+
+    __munmap(addr, 3 * PAGESIZE);
+}
+
 const unsigned char test_sha[2][32] = {
     { 0xca, 0xde, 0xc7, 0x27, 0x1e, 0xaa, 0xd4, 0xc6,
       0x85, 0xa9, 0xc2, 0xc0, 0x57, 0x86, 0xf8, 0x12,
@@ -1454,6 +1498,7 @@ int main(int argc, char * argv[])
     mincore_test();
     mremap_test();
     mprotect_test();
+    madvise_test();
     filebacked_test(h);
     multithread_filebacked_test(h, MT_N_THREADS);
     filebacked_sigbus_test();
@@ -228,6 +228,65 @@ boolean test_range_get_first(bitmap b) {
     return true;
 }
 
+#define SUMMARY_TEST_BITS   (1ull << 20)
+#define SUMMARY_TEST_ALLOCS 8192
+
+/**
+ *  Tests that allocations from a bitmap with summaries match those from a
+ *  plain bitmap, with the maps filled and fragmented by mixed-size allocations.
+ */
+boolean test_summary(heap h)
+{
+    boolean result = false;
+    bitmap b = allocate_bitmap(h, h, SUMMARY_TEST_BITS);
+    bitmap s = allocate_bitmap(h, h, SUMMARY_TEST_BITS);
+    u64 *bits = malloc(SUMMARY_TEST_ALLOCS * sizeof(u64));
+    u64 *sizes = malloc(SUMMARY_TEST_ALLOCS * sizeof(u64));
+    if (!bitmap_enable_summary(s)) {
+        msg_err("!!! failed to enable bitmap summary\n");
+        goto out;
+    }
+    int n = 0;
+    for (int pass = 0; pass < 16; pass++) {
+        while (n < SUMMARY_TEST_ALLOCS) {
+            u64 nbits = (rand() % 8) ? (rand() % 64) + 1 : (rand() % 1024) + 1;
+            u64 start = (rand() % 4) ? 0 : rand() % SUMMARY_TEST_BITS;
+            u64 bit = bitmap_alloc_within_range(b, nbits, start, SUMMARY_TEST_BITS);
+            u64 sbit = bitmap_alloc_within_range(s, nbits, start, SUMMARY_TEST_BITS);
+            if (bit != sbit) {
+                msg_err("!!! summary alloc mismatch: nbits %ld, start %ld, bit %ld, summary bit %ld\n",
+                        nbits, start, bit, sbit);
+                goto out;
+            }
+            if (bit == INVALID_PHYSICAL)
+                break;
+            bits[n] = bit;
+            sizes[n++] = nbits;
+        }
+        /* free a random half to fragment the maps */
+        for (int i = 0; i < n;) {
+            if (rand() & 1) {
+                i++;
+                continue;
+            }
+            if (!bitmap_dealloc(b, bits[i], sizes[i]) || !bitmap_dealloc(s, bits[i], sizes[i])) {
+                msg_err("!!! dealloc failed: bit %ld, nbits %ld\n", bits[i], sizes[i]);
+                goto out;
+            }
+            n--;
+            bits[i] = bits[n];
+            sizes[i] = sizes[n];
+        }
+    }
+    result = true;
+  out:
+    free(bits);
+    free(sizes);
+    deallocate_bitmap(b);
+    deallocate_bitmap(s);
+    return result;
+}
+
 boolean basic_test()
 {
     heap h = init_process_runtime();
@@ -259,6 +318,8 @@ boolean basic_test()
 
     if(!test_range_get_first(b)) return false;
 
+    if (!test_summary(h)) return false;
+
     // deallocate bitmap
     deallocate_bitmap(b);
     return true;
@@ -1,5 +1,10 @@
 #include <runtime.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#ifdef __x86_64__
+#include <cpuid.h>
+#endif
 
 #define MEM_BUF_SIZE    512
 
@@ -108,15 +113,77 @@ static void test_memcmp(long *buf, unsigned long buf_size)
     test_assert(runtime_memcmp(buf, buf, buf_size * sizeof(long)) == 0);
 }
 
-int main(int argc, char *argv[])
+static void test_all(void)
 {
     long buf1[MEM_BUF_SIZE], buf2[MEM_BUF_SIZE];
 
-    init_process_runtime();
     test_memcpy(buf1, buf2, MEM_BUF_SIZE);
     test_memcpy(buf2, buf1, MEM_BUF_SIZE);
     test_memcpy_overlap(buf1, MEM_BUF_SIZE);
     test_memset(buf1, MEM_BUF_SIZE);
     test_memcmp(buf1, MEM_BUF_SIZE);
+}
+
+#define BENCH_BYTES (256ull * MB)
+
+static u64 bench_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * BILLION + ts.tv_nsec;
+}
+
+static u64 bench_rate(u64 ns)
+{
+    return (BENCH_BYTES / MB) * BILLION / MAX(ns, 1);
+}
+
+/* MB/s for each size, moving BENCH_BYTES in total */
+static void bench(const char *impl, u8 *src, u8 *dst)
+{
+    for (bytes len = 16; len <= 4 * MB; len <<= 2) {
+        u64 iterations = BENCH_BYTES / len;
+        u64 start = bench_ns();
+        for (u64 i = 0; i < iterations; i++)
+            runtime_memset(dst, i, len);
+        u64 memset_ns = bench_ns() - start;
+        start = bench_ns();
+        for (u64 i = 0; i < iterations; i++)
+            runtime_memcpy(dst, src, len);
+        u64 memcpy_ns = bench_ns() - start;
+        start = bench_ns();
+        for (u64 i = 0; i < iterations; i++)
+            test_assert(runtime_memcmp(dst, src, len) == 0);
+        u64 memcmp_ns = bench_ns() - start;
+        rprintf("%s %8ld bytes: memset %6ld MB/s, memcpy %6ld MB/s, memcmp %6ld MB/s\n", impl, len,
+                bench_rate(memset_ns), bench_rate(memcpy_ns), bench_rate(memcmp_ns));
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    boolean run_bench = argc > 1 && !strcmp(argv[1], "-b");
+    u8 *src = 0, *dst = 0;
+    init_process_runtime();
+    if (run_bench) {
+        src = malloc(4 * MB);
+        dst = malloc(4 * MB);
+        for (int i = 0; i < 4 * MB; i++)
+            src[i] = i * 7;
+    }
+
+    /* portable routines first, then the ones selected at boot */
+    test_all();
+    if (run_bench)
+        bench("portable", src, dst);
+#ifdef __x86_64__
+    u32 a, b, c, d;
+    if (__get_cpuid_count(7, 0, &a, &b, &c, &d) && (b & (1 << 9))) {
+        memops_erms = true;
+        test_all();
+        if (run_bench)
+            bench("erms    ", src, dst);
+    }
+#endif
     return 0;
 }
@@ -0,0 +1,200 @@
+#include <runtime.h>
+#include <stdlib.h>
+#define EXIT_FAILURE 1
+#define EXIT_SUCCESS 0
+
+#define TEST_TICK_ORDER 10
+#define TEST_TIMERS     4096
+
+static timestamp test_now;
+static boolean test_error;
+
+struct test_timer {
+    struct timer t;
+    timestamp expiry;
+    boolean removed;
+    int fires;
+    u64 overruns;
+    boolean disabled;
+};
+
+closure_function(0, 0, timestamp, test_clock_now)
+{
+    return test_now;
+}
+
+/* the wheel services timers at tick granularity */
+static inline timestamp serviced_until(timestamp here)
+{
+    return (here >> TEST_TICK_ORDER) << TEST_TICK_ORDER;
+}
+
+closure_function(1, 2, void, test_timer_handler,
+                 struct test_timer *, tt,
+                 u64, expiry, u64, overruns)
+{
+    struct test_timer *tt = bound(tt);
+    if (overruns == timer_disabled) {
+        if (tt->disabled) {
+            msg_err("timer %p: duplicate cancel callback\n", tt);
+            test_error = true;
+        }
+        tt->disabled = true;
+        return;
+    }
+    if (tt->t.interval == 0 && tt->expiry > serviced_until(test_now)) {
+        msg_err("timer %p fired early: expiry %ld, now %ld\n", tt, tt->expiry, test_now);
+        test_error = true;
+    }
+    tt->fires++;
+    tt->overruns += overruns;
+}
+
+static u64 rand_u64(void)
+{
+    return ((u64)rand() << 62) ^ ((u64)rand() << 31) ^ rand();
+}
+
+/* delays spread over all levels of the wheel, and beyond */
+static timestamp random_delay(void)
+{
+    return rand_u64() & MASK(rand() % 54);
+}
+
+static boolean check_timers(struct test_timer *timers, int n)
+{
+    timestamp until = serviced_until(test_now);
+    for (int i = 0; i < n; i++) {
+        struct test_timer *tt = &timers[i];
+        int expected = (tt->removed || tt->expiry > until) ? 0 : 1;
+        if (tt->fires != expected) {
+            msg_err("timer %d: expiry %ld, now %ld, removed %d, fires %d\n",
+                    i, tt->expiry, test_now, tt->removed, tt->fires);
+            return false;
+        }
+        if (tt->removed != tt->disabled) {
+            msg_err("timer %d: removed %d, cancel callback %d\n", i, tt->removed, tt->disabled);
+            return false;
+        }
+    }
+    return !test_error;
+}
+
+static boolean random_test(heap h, int passes)
+{
+    struct test_timer *timers = allocate(h, TEST_TIMERS * sizeof(struct test_timer));
+    boolean result = false;
+    timerqueue tq = allocate_timer_wheel(h, closure(h, test_clock_now), TEST_TICK_ORDER, "test");
+    if (tq == INVALID_ADDRESS) {
+        msg_err("failed to allocate timer wheel\n");
+        goto out;
+    }
+    for (int pass = 0; pass < passes; pass++) {
+        timestamp max_expiry = 0;
+        for (int i = 0; i < TEST_TIMERS; i++) {
+            struct test_timer *tt = &timers[i];
+            init_timer(&tt->t);
+            tt->removed = tt->disabled = false;
+            tt->fires = 0;
+            tt->overruns = 0;
+            tt->expiry = test_now + random_delay();
+            max_expiry = MAX(max_expiry, tt->expiry);
+            boolean absolute = rand() & 1;
+            register_timer(tq, &tt->t, CLOCK_ID_MONOTONIC, absolute ? tt->expiry : tt->expiry - test_now,
+                           absolute, 0, closure(h, test_timer_handler, tt));
+            if (tq->next_expiry > ((tt->expiry + MASK(TEST_TICK_ORDER)) & ~MASK(TEST_TICK_ORDER))) {
+                msg_err("next expiry %ld past timer expiry %ld\n", tq->next_expiry, tt->expiry);
+                goto out;
+            }
+        }
+
+        /* most timers are canceled before they fire */
+        for (int i = 0; i < TEST_TIMERS; i++) {
+            if (rand() % 4) {
+                struct test_timer *tt = &timers[i];
+                if (!remove_timer(tq, &tt->t, 0)) {
+                    msg_err("failed to remove timer %d\n", i);
+                    goto out;
+                }
+                tt->removed = true;
+            }
+        }
+
+        while (test_now < max_expiry) {
+            test_now += random_delay() + 1;
+            timer_service(tq, test_now);
+            if (!check_timers(timers, TEST_TIMERS))
+                goto out;
+        }
+        test_now += U64_FROM_BIT(TEST_TICK_ORDER);
+        timer_service(tq, test_now);
+        if (!check_timers(timers, TEST_TIMERS))
+            goto out;
+        for (int i = 0; i < TEST_TIMERS; i++) {
+            if (timers[i].t.queued) {
+                msg_err("timer %d still queued after expiry\n", i);
+                goto out;
+            }
+        }
+    }
+    result = true;
+  out:
+    if (tq != INVALID_ADDRESS)
+        deallocate_timerqueue(tq);
+    deallocate(h, timers, TEST_TIMERS * sizeof(struct test_timer));
+    return result;
+}
+
+static boolean interval_test(heap h)
+{
+    struct test_timer tt;
+    boolean result = false;
+    timerqueue tq = allocate_timer_wheel(h, closure(h, test_clock_now), TEST_TICK_ORDER, "test");
+    if (tq == INVALID_ADDRESS) {
+        msg_err("failed to allocate timer wheel\n");
+        return false;
+    }
+    timestamp interval = U64_FROM_BIT(TEST_TICK_ORDER + 3);
+    timestamp start = serviced_until(test_now) + U64_FROM_BIT(TEST_TICK_ORDER);
+    init_timer(&tt.t);
+    tt.removed = tt.disabled = false;
+    tt.fires = 0;
+    tt.overruns = 0;
+    tt.expiry = start;
+    register_timer(tq, &tt.t, CLOCK_ID_MONOTONIC, start, true, interval,
+                   closure(h, test_timer_handler, &tt));
+    for (int i = 0; i < 1000; i++) {
+        test_now = serviced_until(test_now + random_delay() % (interval * 100));
+        timer_service(tq, test_now);
+        u64 expected = test_now >= start ? (test_now - start) / interval + 1 : 0;
+        if (tt.overruns != expected) {
+            msg_err("interval timer overruns %ld, expected %ld\n", tt.overruns, expected);
+            goto out;
+        }
+    }
+    if (!remove_timer(tq, &tt.t, 0) || !tt.disabled) {
+        msg_err("failed to cancel interval timer\n");
+        goto out;
+    }
+    result = !test_error;
+  out:
+    deallocate_timerqueue(tq);
+    return result;
+}
+
+int main(int argc, char **argv)
+{
+    heap h = init_process_runtime();
+
+    if (!random_test(h, 20))
+        goto fail;
+
+    if (!interval_test(h))
+        goto fail;
+
+    msg_debug("test passed\n");
+    exit(EXIT_SUCCESS);
+  fail:
+    msg_err("test failed\n");
+    exit(EXIT_FAILURE);
+}